@@ -0,0 +1,165 @@
+/*
+Copyright (c) 2019 stoyan shopov
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QByteArray>
+#include <QHash>
+#include <QTime>
+#include <QDebug>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <vector>
+#include <algorithm>
+
+#include "elf-debug-data.hxx"
+
+/* troll-addr2line - an 'addr2line' style symbolizer, built on the troll's DWARF parser.
+ *
+ * Addresses are read from the command line, or streamed from the standard input, and for each address, the
+ * function, the chain of inlined function calls, and the source code coordinates are written to the standard
+ * output, in the format of 'addr2line -a -f -i -p'. Addresses read from the standard input are processed in
+ * batches - each batch is resolved with the batch address queries of the DWARF parser, which sort the addresses,
+ * and interpret the line number program of each compilation unit just once per batch. Results are cached, because
+ * the addresses in crash logs repeat a lot */
+class Symbolizer
+{
+private:
+	enum
+	{
+		/* the result cache is flushed when it grows beyond this number of entries */
+		MAX_CACHED_ADDRESS_COUNT	= 1024 * 1024,
+	};
+	ElfDebugData	debug_data;
+	QHash<uint32_t, QByteArray> cache;
+
+	static QByteArray sourceLocation(const struct ElfDebugData::SourceLocation & location)
+	{
+		return (location.function.isEmpty() ? QByteArray("??") : location.function.toUtf8()) + " at "
+			+ (location.line == -1 ? QByteArray("??:0") : location.file.toUtf8() + ':' + QByteArray::number(location.line)) + '\n';
+	}
+	QByteArray symbolizeAddress(uint32_t address, const std::vector<struct Die> & context, const struct SourceCodeCoordinates & coordinates)
+	{
+		QByteArray result = "0x" + QByteArray::number(address, 16).rightJustified(8, '0') + ": ";
+		auto locations = debug_data.symbolize(address, context, coordinates);
+		int i;
+		for (i = 0; i < locations.size(); i ++)
+			result += (i ? " (inlined by) " : "") + sourceLocation(locations.at(i));
+		return result;
+	}
+public:
+	bool load(const QString & elf_filename, QString & error_message) { return debug_data.load(elf_filename, error_message); }
+	/* Symbolizes a batch of addresses, and appends the results, in the order of the addresses passed, to 'output' */
+	void symbolize(const std::vector<uint32_t> & addresses, QByteArray & output)
+	{
+		std::vector<uint32_t> unresolved_addresses;
+		int i;
+		if (cache.size() + addresses.size() > MAX_CACHED_ADDRESS_COUNT)
+			cache.clear();
+		for (auto address : addresses)
+			if (!cache.contains(address))
+				unresolved_addresses.push_back(address);
+		std::sort(unresolved_addresses.begin(), unresolved_addresses.end());
+		unresolved_addresses.erase(std::unique(unresolved_addresses.begin(), unresolved_addresses.end()), unresolved_addresses.end());
+		auto contexts = debug_data.dwdata->executionContextsForAddresses(unresolved_addresses);
+		auto coordinates = debug_data.dwdata->sourceCodeCoordinatesForAddresses(unresolved_addresses);
+		for (i = 0; i < unresolved_addresses.size(); i ++)
+			cache.insert(unresolved_addresses.at(i), symbolizeAddress(unresolved_addresses.at(i), contexts.at(i), coordinates.at(i)));
+		for (auto address : addresses)
+			output += cache.value(address);
+	}
+};
+
+static bool parseAddress(const char * token, uint32_t & address)
+{
+	char * end;
+	errno = 0;
+	unsigned long x = strtoul(token, & end, 16);
+	if (end == token || * end || errno || x > 0xffffffffUL)
+		return false;
+	return address = x, true;
+}
+
+int main(int argc, char *argv[])
+{
+	QCoreApplication a(argc, argv);
+	QCommandLineParser parser;
+	QCommandLineOption batch_size_option(QStringList() << "b" << "batch-size", "Number of addresses read from the standard input before they are symbolized.", "count", "65536");
+	QString error_message;
+	Symbolizer symbolizer;
+	std::vector<uint32_t> addresses;
+	QByteArray output;
+	uint32_t address;
+	int i, batch_size, address_count = 0;
+	char line[4096];
+	QTime t;
+
+	parser.setApplicationDescription("troll-addr2line - translates addresses to function names, inlining chains and source code coordinates");
+	parser.addHelpOption();
+	parser.addOption(batch_size_option);
+	parser.addPositionalArgument("elf-file", "The ELF file containing the debug information.");
+	parser.addPositionalArgument("addresses", "Hexadecimal addresses to symbolize; if none are given, addresses are read from the standard input.", "[addresses...]");
+	parser.process(a);
+
+	auto positional_arguments = parser.positionalArguments();
+	if (positional_arguments.isEmpty())
+		parser.showHelp(1);
+	batch_size = Util::max(parser.value(batch_size_option).toInt(), 1);
+	if (!symbolizer.load(positional_arguments.at(0), error_message))
+	{
+		fprintf(stderr, "%s\n", error_message.toLocal8Bit().constData());
+		return 1;
+	}
+
+	auto flush = [&] (void)
+	{
+		symbolizer.symbolize(addresses, output);
+		fwrite(output.constData(), 1, output.size(), stdout);
+		fflush(stdout);
+		address_count += addresses.size();
+		addresses.clear();
+		output.clear();
+	};
+
+	t.start();
+	for (i = 1; i < positional_arguments.size(); i ++)
+		if (parseAddress(positional_arguments.at(i).toLocal8Bit().constData(), address))
+			addresses.push_back(address);
+		else
+			fprintf(stderr, "invalid address: %s\n", positional_arguments.at(i).toLocal8Bit().constData());
+	if (positional_arguments.size() == 1) while (fgets(line, sizeof line, stdin))
+	{
+		char * token, * saveptr;
+		for (token = strtok_r(line, " \t\r\n,", & saveptr); token; token = strtok_r(0, " \t\r\n,", & saveptr))
+			if (parseAddress(token, address))
+				addresses.push_back(address);
+			else
+				fprintf(stderr, "invalid address: %s\n", token);
+		if (addresses.size() >= batch_size)
+			flush();
+	}
+	flush();
+	qDebug() << address_count << "addresses symbolized in" << t.elapsed() << "milliseconds";
+	return 0;
+}
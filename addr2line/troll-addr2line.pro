@@ -0,0 +1,30 @@
+#-------------------------------------------------
+#
+# troll-addr2line - a command line symbolizer, built on the troll's DWARF parser
+#
+#-------------------------------------------------
+
+QT       += core
+QT       -= gui
+CONFIG	+= console
+CONFIG	-= app_bundle
+
+TARGET = troll-addr2line
+TEMPLATE = app
+QMAKE_CXXFLAGS += -Wno-sign-compare
+
+# Do not pull the Qt widgets module in libtroll
+DEFINES += LIBTROLL_GUI_ENABLED=0
+
+SOURCES += \
+    main.cxx \
+    ../libtroll/libtroll.cxx
+
+HEADERS += \
+    ../libtroll/dwarf.h \
+    ../libtroll/libtroll.hxx \
+    ../elf-symbol-index.hxx \
+    ../elf-debug-data.hxx \
+    ../util.hxx
+
+INCLUDEPATH += .. ../libtroll/ ../external-sources/ELFIO/
@@ -0,0 +1,54 @@
+/*
+Copyright (c) 2019 stoyan shopov
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+#ifndef BINARYMEMORYDATA_H
+#define BINARYMEMORYDATA_H
+
+#include <QFile>
+#include "memory.hxx"
+
+
+/* Loads raw binary images, placing the file contents at a given base address */
+class BinaryMemoryData
+{
+public:
+	static bool loadFile(const QString & filename, uint32_t base_address, Memory & memory, QString * error_message = 0)
+	{
+		QFile f(filename);
+		if (!f.open(QFile::ReadOnly))
+		{
+			if (error_message)
+				* error_message = QString("cannot open file %1").arg(filename);
+			return false;
+		}
+		if (base_address + (uint64_t) f.size() > 0x100000000ULL)
+		{
+			if (error_message)
+				* error_message = QString("file %1 does not fit in the target address space at base address 0x%2")
+						.arg(filename).arg(base_address, 8, 16, QChar('0'));
+			return false;
+		}
+		memory.addRange(base_address, f.readAll());
+		return true;
+	}
+};
+
+#endif // BINARYMEMORYDATA_H
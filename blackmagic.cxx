@@ -22,114 +22,223 @@ THE SOFTWARE.
 #include "blackmagic.hxx"
 #include <QFile>
 #include <QTime>
-#include <QDialog>
+#include <QMap>
 #include <QMessageBox>
+#include <QTimer>
 #include "memory.hxx"
 #include "gdb-remote.hxx"
+#include "crc32.hxx"
 
 #define BLACKMAGIC_DEBUG 0
 
+Blackmagic::Blackmagic(const QString & transport_specification)
+{
+	this->transport_specification = transport_specification;
+	io = new ProbeIo;
+	io->moveToThread(& io_thread);
+	/* these are queued connections, so the slots are invoked in the front-end thread */
+	QObject::connect(io, SIGNAL(stopReplyReceived(QByteArray,int,qint64)), this, SLOT(stopReplyReceived(QByteArray,int,qint64)));
+	QObject::connect(io, SIGNAL(packetReceived(QByteArray)), this, SLOT(packetReceived(QByteArray)));
+	QObject::connect(io, SIGNAL(connectionLost()), this, SLOT(probeConnectionLost()));
+	io_thread.start();
+}
+
+Blackmagic::~Blackmagic()
+{
+	io->close();
+	io_thread.quit();
+	io_thread.wait();
+	delete io;
+}
+
 void Blackmagic::readAllRegisters(void)
 {
-	putPacket(GdbRemote::readRegistersRequest());
-	auto x = getPacket();
+	auto x = transact(GdbRemote::readRegistersRequest());
 	if (GdbRemote::isErrorResponse(x))
 		Util::panic();
 	registers = GdbRemote::readRegisters(x);
 }
 
-void Blackmagic::putPacket(const QByteArray &request)
+ProbeIo::Reply Blackmagic::wait(std::future<ProbeIo::Reply> future)
 {
-char c;
-	if (BLACKMAGIC_DEBUG) qDebug() << "--> " << request;
-	port->write(request);
-	if (!port->waitForBytesWritten(1000))
-		Util::panic();
-	while ((c = getChar()) != '+')
-		qDebug() << "!!!!!" << c;//Util::panic();
+	wait_depth ++;
+	auto reply = io->wait(std::move(future));
+	if (reply.is_timed_out)
+		/* this also runs a nested event loop, so it is still counted as waiting */
+		QMessageBox::critical(0, "error communicating with the blackmagic", "error reading data from the blackmagic,\ntimeout waiting for a reply!");
+	if (!-- wait_depth && is_halt_pending)
+		/* the caller is still using this object - report the halt from the event loop */
+		QTimer::singleShot(0, this, SLOT(emitPendingHalt()));
+	if (reply.is_timed_out)
+		throw COMMUNICATION_TIMEOUT;
+	if (BLACKMAGIC_DEBUG) qDebug() << "received gdb packets:" << reply.packets;
+	return reply;
 }
 
-QByteArray Blackmagic::getPacket()
+void Blackmagic::stopReplyReceived(QByteArray payload, int signal_number, qint64 timestamp)
 {
-QByteArray packet("$");
-	while (getChar() != '$')
-		;
-	while (1)
+	qDebug() << "halt reason: " << payload << "signal" << signal_number
+		 << "stop reply delivery latency" << (Target::timestamp() - timestamp) / 1000 << "microseconds";
+	if (!is_target_running)
 	{
-		packet += getChar();
-		if (packet[packet.length() - 1] == '#')
-			break;
+		qDebug() << "unexpected stop reply received from the blackmagic, discarding";
+		return;
 	}
-	packet += getChar();
-	packet += getChar();
-	port->write("+");
-	if (!port->waitForBytesWritten(1000))
-		Util::panic();
-	if (BLACKMAGIC_DEBUG) qDebug() << "received gdb packet:" << packet;
-	return packet;
+	is_target_running = false;
+	halt_timestamp = timestamp;
+	reportHalt(GdbRemote::isTerminationStopReply(payload) ? TARGET_LOST : GENERIC_HALT_CONDITION);
 }
 
-char Blackmagic::getChar()
+void Blackmagic::packetReceived(QByteArray payload)
 {
-char c;
-int retries = MAX_GETCHAR_RETRIES;
-	while (!port->bytesAvailable() && -- retries)
-		port->waitForReadyRead(10);
-	if (!retries)
+	if (ProbeIo::isConsoleOutputPacket(payload))
 	{
-		QMessageBox::critical(0, "error communicating with the blackmagic", "error reading data from the blackmagic,\nmaximum data read retry count exceeded!");
-		throw COMMUNICATION_TIMEOUT;
+		qDebug() << "blackmagic console output:" << QByteArray::fromHex(payload.mid(1));
+		return;
+	}
+	qDebug() << "unexpected packet received from the blackmagic:" << payload;
+	if (is_target_running && GdbRemote::isErrorResponse(payload))
+	{
+		/* the blackmagic reports errors (e.g., 'EFF') if the target is lost while running */
+		is_target_running = false;
+		halt_timestamp = 0;
+		reportHalt(TARGET_LOST);
 	}
-	if (port->read(& c, 1) != 1)
-		Util::panic();
-	return c;
 }
 
-void Blackmagic::portReadyRead()
+void Blackmagic::probeConnectionLost(void)
 {
-auto halt_reason = getPacket();
-	qDebug() << "halt reason: " << halt_reason;
-	if (!disconnect(port, SIGNAL(readyRead()), 0, 0))
-		Util::panic();
-	if (GdbRemote::packetData(halt_reason) == "T05"
-		|| GdbRemote::packetData(halt_reason) == "T02")
-		emit targetHalted(GENERIC_HALT_CONDITION);
-	else if (GdbRemote::packetData(halt_reason) == "X1D" || GdbRemote::packetData(halt_reason) == "EFF")
+	is_target_running = false;
+	halt_timestamp = 0;
+	reportHalt(TARGET_LOST);
+}
+
+void Blackmagic::reportHalt(TARGET_HALT_REASON reason)
+{
+	if (!wait_depth)
 	{
-		port = 0;
-		emit targetHalted(TARGET_LOST);
+		emit targetHalted(reason);
+		return;
 	}
-	else
+	/* a lost target takes precedence over any other halt reason */
+	if (!is_halt_pending || reason == TARGET_LOST)
+		pending_halt_reason = reason;
+	is_halt_pending = true;
+}
+
+void Blackmagic::emitPendingHalt(void)
+{
+	if (!is_halt_pending || wait_depth)
+		return;
+	is_halt_pending = false;
+	emit targetHalted(pending_halt_reason);
+}
+
+QVector<QByteArray> Blackmagic::transact(const QVector<QByteArray> & requests)
+{
+	auto replies = wait(io->submit(requests, is_no_ack_mode ? pipeline_depth : 1)).packets;
+	if (replies.size() != requests.size())
 		Util::panic();
+	return replies;
 }
 
 bool Blackmagic::reset()
 {
 	registers.clear();
-	putPacket(GdbRemote::resetRequest());
+	io->post(GdbRemote::resetRequest());
+	return true;
+}
+
+bool Blackmagic::readMemory(uint32_t address, int byte_count, QByteArray & data)
+{
+	data.clear();
+	while (data.size() < byte_count)
+	{
+		int size = data.size();
+		auto replies = transact(GdbRemote::readMemoryRequest(address + size, byte_count - size, memory_read_chunk_size, is_binary_memory_read_supported));
+		for (const auto & reply : replies)
+		{
+			if (GdbRemote::isErrorResponse(reply))
+				return false;
+			int expected_size = Util::min(byte_count - data.size(), memory_read_chunk_size);
+			auto chunk = GdbRemote::readMemoryData(reply, is_binary_memory_read_supported);
+			data += chunk.left(expected_size);
+			if (chunk.size() < expected_size)
+				/* Short reply - discard the replies to the requests following it,
+				 * and request the rest of the data again */
+				break;
+		}
+		if (data.size() == size)
+			/* no progress */
+			return false;
+	}
 	return true;
 }
 
 QByteArray Blackmagic::readBytes(uint32_t address, int byte_count, bool is_failure_allowed)
 {
-QVector<QByteArray> r;
-int i;
-	auto m = GdbRemote::readMemoryRequest(address, byte_count);
-	for (r.clear(), i = 0; i < m.size(); i ++)
+QByteArray data, image_data;
+	if (immutableMemoryData(address, byte_count, image_data) && !isImmutableMemorySpotCheckDue())
+		return image_data;
+	if (!readMemory(address, byte_count, data))
 	{
-		putPacket(m[i]);
-		r += getPacket();
+		if (!is_failure_allowed)
+		{
+			throw MEMORY_READ_ERROR;
+			Util::panic();
+		}
+		else
+			return QByteArray();
 	}
-	for (i = 0; i < r.size(); i ++)
-		if (GdbRemote::isErrorResponse(r[i]))
-			if (!is_failure_allowed)
+	if (!image_data.isEmpty())
+		verifyImmutableMemorySpotCheck(address, image_data, data);
+	return data;
+}
+
+QVector<QByteArray> Blackmagic::readRanges(const QVector<QPair<uint32_t, int> > & ranges)
+{
+QVector<QByteArray> data(ranges.size()), requests;
+QVector<QPair<uint32_t, int> > wire_ranges;
+QVector<int> wire_range_indices, packet_counts;
+QVector<QVector<int> > span_ranges;
+int i, j;
+	/* serve whatever is possible from the immutable memory areas, and read the rest from the target */
+	for (i = 0; i < ranges.size(); i ++)
+		if (!immutableMemoryData(ranges[i].first, ranges[i].second, data[i]))
+			wire_ranges.push_back(ranges[i]), wire_range_indices.push_back(i);
+	auto spans = coalesceRanges(wire_ranges, READ_RANGES_COALESCING_GAP, span_ranges);
+	for (i = 0; i < spans.size(); i ++)
+	{
+		auto m = GdbRemote::readMemoryRequest(spans[i].first, spans[i].second, memory_read_chunk_size, is_binary_memory_read_supported);
+		requests += m;
+		packet_counts.push_back(m.size());
+	}
+	auto replies = transact(requests);
+	for (i = j = 0; i < spans.size(); j += packet_counts[i ++])
+	{
+		QByteArray span_data;
+		bool is_span_read = true;
+		for (const auto & reply : replies.mid(j, packet_counts[i]))
+		{
+			int expected_size = Util::min(spans[i].second - span_data.size(), memory_read_chunk_size);
+			auto chunk = GdbRemote::readMemoryData(reply, is_binary_memory_read_supported);
+			if (GdbRemote::isErrorResponse(reply) || chunk.size() < expected_size)
 			{
-				throw MEMORY_READ_ERROR;
-				Util::panic();
+				is_span_read = false;
+				break;
 			}
-			else
-				return QByteArray();
-	return GdbRemote::readMemory(r);
+			span_data += chunk.left(expected_size);
+		}
+		if (is_span_read)
+			for (auto k : span_ranges[i])
+				data[wire_range_indices[k]] = span_data.mid(wire_ranges[k].first - spans[i].first, wire_ranges[k].second);
+		else
+			/* the coalesced span may be covering inaccessible memory, or a short reply
+			 * may have been received - read the individual ranges one by one */
+			for (auto k : span_ranges[i])
+				data[wire_range_indices[k]] = readBytes(wire_ranges[k].first, wire_ranges[k].second, true);
+	}
+	return data;
 }
 
 uint32_t Blackmagic::readRawUncachedRegister(uint32_t register_number)
@@ -143,130 +252,87 @@ uint32_t Blackmagic::readRawUncachedRegister(uint32_t register_number)
 
 bool Blackmagic::breakpointSet(uint32_t address, int length)
 {
-	putPacket(GdbRemote::setHardwareBreakpointRequest(address, length));
-	return GdbRemote::isOkResponse(getPacket()) ? true : false;
+	return GdbRemote::isOkResponse(transact(GdbRemote::setHardwareBreakpointRequest(address, length))) ? true : false;
 }
 
 bool Blackmagic::breakpointClear(uint32_t address, int length)
 {
-	putPacket(GdbRemote::removeHardwareBreakpointRequest(address, length));
-	return GdbRemote::isOkResponse(getPacket()) ? true : false;
+	return GdbRemote::isOkResponse(transact(GdbRemote::removeHardwareBreakpointRequest(address, length))) ? true : false;
 }
 
 void Blackmagic::requestSingleStep(void)
 {
 	emit targetRunning();
 	registers.clear();
-	putPacket(GdbRemote::singleStepRequest());
-	if (!QObject::connect(port, SIGNAL(readyRead()), this, SLOT(portReadyRead())))
-		Util::panic();
-	/*! \todo	WARNING - it seems that I am doing something wrong with the 'readyRead()' signal;
-	 *		without the call to 'waitForReadyRead()' below, on one machine that I am testing on,
-	 *		incoming data from the blackmagic probe sometimes does not cause the 'readyRead()'
-	 *		signal to be emitted, which breaks the code badly; I discovered through trial and
-	 *		error that the call to 'WaitForReadyRead()' function below seems to work around this issue
-	 * 		on some (but not all) machines that I tested on
-	 *
-	 * 		the same call is also currently present in the main troll front-end code, in file 'troll.cxx',
-	 * 		where waitForReadyRead() is being periodically called when the target is running - while the
-	 * 		call there is in my tests sufficient to work around the issue, the duplication here makes
-	 * 		the troll more responsive on some machines; tests concluded that just the call here (and without
-	 * 		periodically calling waitForReadyRead()) ***DOES NOT WORK*** in all occasions, so the redundant
-	 * 		call here is intended only to make the troll more responsive on some machines
-	 */
-	port->waitForReadyRead(1);
+	is_target_running = true;
+	/* the stop reply is delivered by the probe input/output thread, with the 'packetReceived()' signal */
+	io->post(GdbRemote::singleStepRequest());
 }
 
 bool Blackmagic::resume(void)
 {
 	emit targetRunning();
 	registers.clear();
-	putPacket(GdbRemote::continueRequest());
-	if (!QObject::connect(port, SIGNAL(readyRead()), this, SLOT(portReadyRead())))
-		Util::panic();
-	/*! \todo	WARNING - it seems that I am doing something wrong with the 'readyRead()' signal;
-	 *		without the call to 'waitForReadyRead()' below, on one machine that I am testing on,
-	 *		incoming data from the blackmagic probe sometimes does not cause the 'readyRead()'
-	 *		signal to be emitted, which breaks the code badly; I discovered through trial and
-	 *		error that the call to 'WaitForReadyRead()' function below seems to work around this issue
-	 * 		on some (but not all) machines that I tested on
-	 *
-	 * 		the same call is also currently present in the main troll front-end code, in file 'troll.cxx',
-	 * 		where waitForReadyRead() is being periodically called when the target is running - while the
-	 * 		call there is in my tests sufficient to work around the issue, the duplication here makes
-	 * 		the troll more responsive on some machines; tests concluded that just the call here (and without
-	 * 		periodically calling waitForReadyRead()) ***DOES NOT WORK*** in all occasions, so the redundant
-	 * 		call here is intended only to make the troll more responsive on some machines
-	 */
-	port->waitForReadyRead(1);
+	is_target_running = true;
+	io->post(GdbRemote::continueRequest());
 	return true;
 }
 
 bool Blackmagic::requestHalt()
 {
-	if (port->write("\003") == -1)
-		Util::panic();
+	io->interrupt();
 	return true;
 }
 
 bool Blackmagic::connect(void)
 {
 	int i;
-	QVector<QByteArray> r, s;
+	QVector<QByteArray> r;
 	QString scan_reply;
 
-	if (!port->setDataTerminalReady(true))
-		Util::panic();
-	port->write("+++");
-	port->waitForBytesWritten(500);
-	port->readAll();
-	qDebug() << "--------------> +++";
-
-	QByteArray reply;
-	do
-	{
-		port->waitForReadyRead(500);
-		reply = port->readAll();
-		qDebug() << reply;
-	}
-	while (port->readAll() > 0);
+	if (!io->open(transport_specification, write_coalescing_limit, read_batching_delay))
+		return false;
 	
 	try
 	{
-		putPacket(GdbRemote::monitorRequest("tpwr enable"));
-	}
-	catch (...)
-	{
-		return false;
-	}
+		monitor("tpwr enable");
 
-	do
-		r.push_back(getPacket());
-	while (!GdbRemote::isOkResponse(r.back()) && !GdbRemote::isErrorResponse(r.back()));
+		/* Negotiate the protocol features supported by the blackmagic. The maximum packet size
+		 * determines the most appropriate chunk size for accessing target memory, and binary
+		 * memory reads halve the number of bytes transferred for reading target memory */
+		auto features = GdbRemote::supportedFeatures(transact(GdbRemote::supportedFeaturesRequest()));
+		qDebug() << "blackmagic supported features:" << features;
+		bool ok;
+		int packet_size = features.value("PacketSize").toInt(& ok, 16);
+		if (ok && packet_size > PACKET_SIZE_MARGIN + 2)
+			max_packet_size = packet_size;
+		is_binary_memory_read_supported = features.value("binary-upload") == "+";
+		memory_read_chunk_size = max_packet_size - PACKET_SIZE_MARGIN;
+		if (!is_binary_memory_read_supported)
+			/* hex encoded memory read replies take two bytes per target memory byte */
+			memory_read_chunk_size /= 2;
+		qDebug() << "blackmagic maximum packet size" << max_packet_size << "memory read chunk size" << memory_read_chunk_size
+			 << (is_binary_memory_read_supported ? "binary memory reads" : "hex memory reads");
 
-	/*! \todo	Properly issue a 'qSupported' gdb remote protocol request, process
-	 * 		blackmagic response, and properly determine the maximum packet size -
-	 * 		this is important for determining the most appropriate packet size
-	 * 		for accessing target memory, and for reading target description xml
-	 * 		documents from the blackmagic */
+		/* Switch to no-acknowledgment mode, if the blackmagic supports it - this is
+		 * needed for pipelining requests */
+		if (features.value("QStartNoAckMode") == "+")
+		{
+			is_no_ack_mode = GdbRemote::isOkResponse(transact(GdbRemote::startNoAckModeRequest()));
+			io->setNoAckMode(is_no_ack_mode);
+		}
+		qDebug() << "blackmagic no-acknowledgment mode" << (is_no_ack_mode ? "enabled" : "not supported");
 
-	try
-	{
-		putPacket(GdbRemote::monitorRequest("swdp_scan"));
+		r = monitor("swdp_scan");
 	}
 	catch (...)
 	{
 		return false;
 	}
 
-	r.clear();
-	do
-		r.push_back(getPacket());
-	while (!GdbRemote::isOkResponse(r.back()) && !GdbRemote::isErrorResponse(r.back()));
-
 	for (i = 0; i < r.size() - 1; i ++)
 	{
-		auto s = GdbRemote::packetData(r[i]);
+		auto & s = r[i];
 		if (s[0] == 'O')
 			scan_reply += QByteArray::fromHex(s.mid(1));
 	}
@@ -276,67 +342,158 @@ bool Blackmagic::connect(void)
 		QMessageBox::critical(0, "blackmagic target scan failed", QString("blackmagic target scan failed, response:\n\n") + scan_reply);
 		return false;
 	}
-	putPacket(GdbRemote::attachRequest());
-	if (GdbRemote::packetData(getPacket()) != "T05")
+	if (transact(GdbRemote::attachRequest()) != "T05")
 		Util::panic();
 	return true;
 }
 
 QByteArray Blackmagic::memoryMap(void)
 {
-	putPacket(GdbRemote::memoryMapReadRequest());
-	return GdbRemote::memoryMapReadData(getPacket());
+	return GdbRemote::memoryMapReadData(transact(GdbRemote::memoryMapReadRequest()));
+}
+
+bool Blackmagic::memoryCrcs(const QVector<QPair<uint32_t, int> > & ranges, QVector<uint32_t> & crcs)
+{
+QVector<QByteArray> requests;
+int i;
+	for (i = 0; i < ranges.size(); i ++)
+		requests.push_back(GdbRemote::crcRequest(ranges[i].first, ranges[i].second));
+	auto replies = transact(requests);
+	crcs.resize(ranges.size());
+	for (i = 0; i < replies.size(); i ++)
+		if (!GdbRemote::crcValue(replies[i], crcs[i]))
+			return false;
+	return true;
 }
 
 bool Blackmagic::syncFlash(const Memory &memory_contents)
 {
 	QTime t;
 	int i;
-	QString s;
-	uint32_t total;
+	uint32_t total, done;
+	/* the parts of the memory image residing in each flash erase block, keyed by erase block start address */
+	struct flash_block
+	{
+		uint32_t	size;
+		QVector<QPair<uint32_t, int> > image_ranges;
+		bool		is_dirty;
+	};
+	QMap<uint32_t, struct flash_block> blocks;
+	QVector<QPair<uint32_t, int> > image_ranges, erase_ranges, write_ranges;
+	QVector<uint32_t> crcs;
+	QVector<QByteArray> requests;
+	QVector<int> chunk_sizes;
+
 	memory_contents.dump();
-	if (memory_contents.isMemoryMatching(this))
-		return true;
-	auto ranges = flashAreasForRange(memory_contents.ranges[0].address, memory_contents.ranges[0].data.size());
-	if (memory_contents.ranges.size() != 1 || ranges.empty())
-		Util::panic();
-	QDialog dialog;
-	Ui::Notification mbox;
-	mbox.setupUi(& dialog);
-	dialog.setWindowTitle("erasing flash");
+	clearImmutableMemoryAreas();
+
+	/* Delta flash programming - split the memory image along the flash erase block boundaries,
+	 * compare the crc of each part to the crc computed on the target, and only erase and rewrite
+	 * the flash blocks which do not match the memory image */
+	for (const auto & range : memory_contents.ranges)
+	{
+		auto x = flashBlocksForRange(range.address, range.data.size());
+		if (x.empty())
+			Util::panic();
+		for (const auto & b : x)
+		{
+			uint64_t start = Util::max((uint64_t) range.address, (uint64_t) b.first);
+			uint64_t end = Util::min((uint64_t) range.address + range.data.size(), (uint64_t) b.first + b.second);
+			auto & block = blocks[b.first];
+			block.size = b.second;
+			block.is_dirty = false;
+			block.image_ranges.push_back(QPair<uint32_t, int>(start, end - start));
+			image_ranges.push_back(block.image_ranges.back());
+		}
+	}
+	for (total = i = 0; i < image_ranges.size(); total += image_ranges[i ++].second)
+		;
+	reportFlashProgress(FLASH_COMPARE, 0, total, 0);
 	t.start();
-	for (total = i = 0; i < ranges.size(); i ++)
+	if (memoryCrcs(image_ranges, crcs))
 	{
-		mbox.label->setText(QString("erasing flash at start address $%1, size $%2").arg(ranges[i].first, 0, 16).arg(ranges[i].second, 0, 16));
-		dialog.show();
-		QApplication::processEvents();
-		
-		putPacket(GdbRemote::eraseFlashMemoryRequest(ranges[i].first, ranges[i].second));
-		if (!GdbRemote::isOkResponse(getPacket()))
+		for (i = 0; i < image_ranges.size(); i ++)
 		{
-			QMessageBox::critical(0, "error erasing flash", QString("error erasing $%1 bytes of flash at address $%2").arg(ranges[i].second, 0, 16).arg(ranges[i].first, 0, 16));
-			Util::panic();
+			auto data = memory_contents.data(image_ranges[i].first, image_ranges[i].second);
+			if (Crc32::crc32(data.constData(), data.size()) != crcs[i])
+				(-- blocks.upperBound(image_ranges[i].first))->is_dirty = true;
 		}
-		total += ranges[i].second;
 	}
-	qDebug() << "flash erase speed" << QString("%1 bytes per second").arg((float) (total * 1000.) / t.elapsed());
-	dialog.setWindowTitle("writing flash");
-	mbox.label->setText(QString("writing $%1 bytes to flash at start address $%2")
-	                    .arg(memory_contents.ranges[0].data.size(), 0, 16)
-	                .arg(memory_contents.ranges[0].address, 0, 16));
-	QApplication::processEvents();
+	else
+	{
+		/* the blackmagic does not support computing checksums, compare the flash contents */
+		qDebug() << "target side crc computation not supported, reading back flash contents";
+		auto x = readRanges(image_ranges);
+		for (i = 0; i < image_ranges.size(); i ++)
+			if (x[i] != memory_contents.data(image_ranges[i].first, image_ranges[i].second))
+				(-- blocks.upperBound(image_ranges[i].first))->is_dirty = true;
+	}
+	reportFlashProgress(FLASH_COMPARE, total, total, t.elapsed());
+	/* Coalesce adjacent dirty blocks, and the image ranges in them. Erase requests are limited in
+	 * size, so that the blackmagic replies to each of them before the reply timeout expires */
+	for (auto b = blocks.constBegin(); b != blocks.constEnd(); b ++)
+	{
+		if (!b->is_dirty)
+			continue;
+		if (!erase_ranges.isEmpty() && erase_ranges.back().first + erase_ranges.back().second == b.key()
+				&& erase_ranges.back().second + b->size <= MAX_FLASH_ERASE_REQUEST_SIZE)
+			erase_ranges.back().second += b->size;
+		else
+			erase_ranges.push_back(QPair<uint32_t, int>(b.key(), b->size));
+		for (const auto & r : b->image_ranges)
+			if (!write_ranges.isEmpty() && write_ranges.back().first + write_ranges.back().second == r.first)
+				write_ranges.back().second += r.second;
+			else
+				write_ranges.push_back(r);
+	}
+	qDebug() << "flash blocks compared in" << t.elapsed() << "milliseconds," << blocks.size() << "blocks total," << erase_ranges.size() << "dirty block ranges";
+	if (erase_ranges.isEmpty())
+	{
+		enableImmutableMemoryAreas(memory_contents);
+		return true;
+	}
 
+	for (total = i = 0; i < erase_ranges.size(); total += erase_ranges[i ++].second)
+		;
+	reportFlashProgress(FLASH_ERASE, 0, total, 0);
 	t.restart();
-	auto r = GdbRemote::writeFlashMemoryRequest(memory_contents.ranges[0].address, memory_contents.ranges[0].data.size(), memory_contents.ranges[0].data);
-	for (i = 0; i < r.size(); i ++)
+	for (done = i = 0; i < erase_ranges.size(); i ++)
 	{
-		putPacket(r[i]);
-		if (!GdbRemote::isOkResponse(getPacket()))
+		if (!GdbRemote::isOkResponse(transact(GdbRemote::eraseFlashMemoryRequest(erase_ranges[i].first, erase_ranges[i].second))))
 		{
-			QMessageBox::critical(0, "error writing flash", QString("error writing $%1 bytes of flash at address $%2").arg(memory_contents.ranges[0].data.size(), 0, 16).arg(memory_contents.ranges[0].address, 0, 16));
+			QMessageBox::critical(0, "error erasing flash", QString("error erasing $%1 bytes of flash at address $%2").arg(erase_ranges[i].second, 0, 16).arg(erase_ranges[i].first, 0, 16));
 			Util::panic();
 		}
+		reportFlashProgress(FLASH_ERASE, done += erase_ranges[i].second, total, t.elapsed());
 	}
-	qDebug() << "flash write speed" << QString("%1 bytes per second").arg((float) (memory_contents.ranges[0].data.size() * 1000.) / t.elapsed());
-	return memory_contents.isMemoryMatching(this);
+	qDebug() << "flash erase speed" << QString("%1 bytes per second").arg((float) (total * 1000.) / t.elapsed());
+
+	/* Fill each write request up to the maximum packet size of the blackmagic, and keep several
+	 * write requests in flight (in no-acknowledgment mode), reporting progress after each batch */
+	for (total = i = 0; i < write_ranges.size(); total += write_ranges[i ++].second)
+		requests += GdbRemote::flashWriteRequests(write_ranges[i].first, memory_contents.data(write_ranges[i].first, write_ranges[i].second),
+							    max_packet_size - PACKET_SIZE_MARGIN, & chunk_sizes);
+	reportFlashProgress(FLASH_WRITE, 0, total, 0);
+	t.restart();
+	for (done = i = 0; i < requests.size(); i += FLASH_WRITE_BATCH_SIZE)
+	{
+		auto replies = transact(requests.mid(i, FLASH_WRITE_BATCH_SIZE));
+		for (int j = 0; j < replies.size(); done += chunk_sizes[i + j ++])
+			if (!GdbRemote::isOkResponse(replies[j]))
+			{
+				QMessageBox::critical(0, "error writing flash", QString("error writing flash, write request %1 of %2 failed").arg(i + j + 1).arg(requests.size()));
+				Util::panic();
+			}
+		reportFlashProgress(FLASH_WRITE, done, total, t.elapsed());
+	}
+	if (!GdbRemote::isOkResponse(transact(GdbRemote::flashDoneRequest())))
+	{
+		QMessageBox::critical(0, "error writing flash", "error completing flash programming");
+		Util::panic();
+	}
+	qDebug() << "flash write speed" << QString("%1 bytes per second").arg((float) (total * 1000.) / t.elapsed()) << requests.size() << "write requests";
+	if (!memory_contents.isMemoryMatching(this))
+		return false;
+	enableImmutableMemoryAreas(memory_contents);
+	return true;
 }
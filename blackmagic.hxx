@@ -22,10 +22,12 @@ THE SOFTWARE.
 #ifndef BLACKMAGIC_HXX
 #define BLACKMAGIC_HXX
 
-#include <QSerialPort>
+#include <QThread>
 #include <QVector>
 
 #include "target.hxx"
+#include "gdb-remote.hxx"
+#include "probe-io.hxx"
 
 class Blackmagic : public Target
 {
@@ -33,27 +35,86 @@ Q_OBJECT
 private:
 	enum
 	{
-		MAX_GETCHAR_RETRIES	=	200,
+		/* memory ranges that are at most this number of bytes apart are read with a single request */
+		READ_RANGES_COALESCING_GAP	=	32,
+		/* packet size assumed, if the blackmagic does not report its maximum packet size */
+		DEFAULT_MAX_PACKET_SIZE		=	0x400,
+		/* space reserved in a packet for packet framing and request/reply headers */
+		PACKET_SIZE_MARGIN		=	24,
+		/* maximum size of a flash erase request, when erasing adjacent flash blocks */
+		MAX_FLASH_ERASE_REQUEST_SIZE	=	16 * 1024,
+		/* number of flash write requests sent between progress reports */
+		FLASH_WRITE_BATCH_SIZE		=	16,
 	};
 	QVector<uint32_t>	registers;
-	QSerialPort	* port;
+	/* all communication with the blackmagic is performed by a probe input/output
+	 * object, which lives in a dedicated thread */
+	QThread		io_thread;
+	ProbeIo		* io;
+	/* as accepted by 'ProbeTransport::create()' */
+	QString		transport_specification;
+	int		write_coalescing_limit = -1, read_batching_delay = -1;
+	/* set when the target has been resumed, or single-stepped, and a stop reply is expected */
+	bool is_target_running = false;
+	/* set when the blackmagic has accepted a 'QStartNoAckMode' request; pipelining
+	 * of requests is only performed in no-acknowledgment mode */
+	bool is_no_ack_mode = false;
+	int pipeline_depth = DEFAULT_PIPELINE_DEPTH;
+	/* protocol features, negotiated with a 'qSupported' request on connecting to the blackmagic */
+	int max_packet_size = DEFAULT_MAX_PACKET_SIZE;
+	int memory_read_chunk_size = (DEFAULT_MAX_PACKET_SIZE - PACKET_SIZE_MARGIN) / 2;
+	bool is_binary_memory_read_supported = false;
+	/* Waiting for a reply runs a nested event loop, in which halt notifications (stop replies, a lost connection)
+	 * may be received. The handlers of 'targetHalted()' access the target, and may even delete it, so halt
+	 * notifications received while a wait is in progress are deferred until no wait is in progress anymore */
+	int wait_depth = 0;
+	bool is_halt_pending = false;
+	TARGET_HALT_REASON pending_halt_reason;
+	void reportHalt(TARGET_HALT_REASON reason);
 	void readAllRegisters(void);
-	void putPacket(const QByteArray & request);
-	QByteArray getPacket(void);
-	char getChar(void);
+	/* waits for the completion of a request submitted to the probe input/output thread;
+	 * throws COMMUNICATION_TIMEOUT if the blackmagic does not respond */
+	struct ProbeIo::Reply wait(std::future<struct ProbeIo::Reply> future);
+	/* sends all of the packets in 'requests', and returns the replies received, in order;
+	 * in no-acknowledgment mode, up to 'pipeline_depth' requests are kept in flight, and
+	 * if the blackmagic responds with an error, the remaining requests are sent in
+	 * stop-and-wait mode */
+	QVector<QByteArray> transact(const QVector<QByteArray> & requests);
+	QByteArray transact(const QByteArray & request) { return transact(QVector<QByteArray>(1, request)).at(0); }
+	/* sends a monitor command, and returns all packets received in response to it -
+	 * the console output packets, followed by the final reply packet */
+	QVector<QByteArray> monitor(const QString & command) { return wait(io->submit(QVector<QByteArray>(1, GdbRemote::monitorRequest(command)), 1, true)).packets; }
+	/* reads target memory, handling short replies to memory read requests;
+	 * returns false if target memory could not be read */
+	bool readMemory(uint32_t address, int byte_count, QByteArray & data);
 private slots:
-	void portReadyRead(void);
+	void stopReplyReceived(QByteArray payload, int signal_number, qint64 timestamp);
+	void packetReceived(QByteArray payload);
+	void probeConnectionLost(void);
+	void emitPendingHalt(void);
 public:
 	enum BLACKMAGIC_COMMUNICATION_ERROR
 	{
 		INVALID			=	0,
 		COMMUNICATION_TIMEOUT,
 	};
+	enum
+	{
+		/* default number of requests kept in flight when pipelining requests to the blackmagic */
+		DEFAULT_PIPELINE_DEPTH		=	4,
+	};
 
-	Blackmagic(QSerialPort * port) { this->port = port; }
+	Blackmagic(const QString & transport_specification);
+	~Blackmagic();
+	/* a pipeline depth of 1 disables pipelining */
+	void setPipelineDepth(int depth) { pipeline_depth = Util::max(depth, 1); }
+	/* negative values select the transport defaults; must be called before 'connect()' */
+	void setTransportTuning(int write_coalescing_limit, int read_batching_delay)
+	{ this->write_coalescing_limit = write_coalescing_limit; this->read_batching_delay = read_batching_delay; }
 	uint32_t readWord(uint32_t address) { auto x = readBytes(address, sizeof(uint32_t)); if (x.size() != sizeof(uint32_t)) Util::panic(); return * (uint32_t *) x.constData(); }
 	bool reset(void);
 	QByteArray readBytes(uint32_t address, int byte_count, bool is_failure_allowed = false);
+	QVector<QByteArray> readRanges(const QVector<QPair<uint32_t, int> > & ranges);
 	uint32_t readRawUncachedRegister(uint32_t register_number);
 	bool breakpointSet(uint32_t address, int length);
 	bool breakpointClear(uint32_t address, int length);
@@ -64,6 +125,7 @@ public:
 	uint32_t haltReason(void){ Util::panic(); }
 	QByteArray memoryMap(void);
 	bool syncFlash(const Memory & memory_contents);
+	bool memoryCrcs(const QVector<QPair<uint32_t, int> > & ranges, QVector<uint32_t> & crcs);
 };
 
 #endif // BLACKMAGIC_HXX
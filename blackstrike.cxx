@@ -24,6 +24,7 @@ THE SOFTWARE.
 #include <QMessageBox>
 #include "blackstrike.hxx"
 #include "memory.hxx"
+#include "ui_notification.h"
 
 #define BLACKSTIRKE_DEBUG	0
 
@@ -36,13 +37,15 @@ QTime t;
 
 	t.start();
 	registers.clear();
-	if (port->write("swdp-scan drop gdb-attach drop\n") == -1) Util::panic();
-	if (port->write(".( <<<start>>>)cr ?regs .( <<<end>>>)cr\n") == -1) Util::panic();
+	transport->write("swdp-scan drop gdb-attach drop\n");
+	transport->write(".( <<<start>>>)cr ?regs .( <<<end>>>)cr\n");
+	transport->flush();
 	do
 	{
-		if (port->bytesAvailable())
-			s += port->readAll();
-		else if (!port->waitForReadyRead(2000))
+		auto x = transport->readAll();
+		if (!x.isEmpty())
+			s += x;
+		else if (!transport->waitForReadyRead(2000))
 			Util::panic();
 	}
 	while (!s.contains("<<<end>>>"));
@@ -66,10 +69,10 @@ QTime t;
 	qDebug() << "target register read took" << t.elapsed() << "milliseconds";
 }
 
-void Blackstrike::portReadyRead()
+void Blackstrike::transportDataReceived()
 {
-QString halt_reason = port->readAll();
-	if (!disconnect(port, SIGNAL(readyRead()), 0, 0))
+QString halt_reason = transport->readAll();
+	if (!disconnect(transport, SIGNAL(dataReceived()), 0, 0))
 		Util::panic();
 	if (halt_reason.contains("target-halted-breakpoint"))
 		emit targetHalted(BREAKPOINT_HIT);
@@ -93,12 +96,14 @@ QTime t;
 	t.start();
 	if (isOk)
 		* isOk = true;
-	if (port->write(query + '\n') == -1) Util::panic();
+	transport->write(query + '\n');
+	transport->flush();
 	do
 	{
-		if (port->bytesAvailable())
-			s += port->readAll();
-		else if (!port->waitForReadyRead(6000))
+		auto x = transport->readAll();
+		if (!x.isEmpty())
+			s += x;
+		else if (!transport->waitForReadyRead(6000))
 		{
 			if (isOk)
 				* isOk = false;
@@ -133,9 +138,14 @@ QString s(
 " $%1 $%2 "
 " .( <<<start>>>) target-dump .( <<<end>>>) cr "
 );
+QByteArray image_data;
+	if (immutableMemoryData(address, byte_count, image_data) && !isImmutableMemorySpotCheckDue())
+		return image_data;
 	t.start();
 	auto x = interrogate(s.arg(address, 0, 16).arg(byte_count, 0, 16).toLocal8Bit());
 	qDebug() << "usb xfer speed:" << ((float) x.length() / t.elapsed()) * 1000. << "bytes/second";
+	if (!image_data.isEmpty())
+		verifyImmutableMemorySpotCheck(address, image_data, x);
 	return x;
 }
 
@@ -183,26 +193,26 @@ bool Blackstrike::breakpointClear(uint32_t address, int length)
 void Blackstrike::requestSingleStep()
 {
 	emit targetRunning();
-	QObject::connect(port, SIGNAL(readyRead()), this, SLOT(portReadyRead()));
+	QObject::connect(transport, SIGNAL(dataReceived()), this, SLOT(transportDataReceived()));
 	registers.clear();
-	if (port->write("step\n") == -1)
-		Util::panic();
+	transport->write("step\n");
+	transport->flush();
 }
 
 bool Blackstrike::resume()
 {
 	emit targetRunning();
-	QObject::connect(port, SIGNAL(readyRead()), this, SLOT(portReadyRead()));
+	QObject::connect(transport, SIGNAL(dataReceived()), this, SLOT(transportDataReceived()));
 	registers.clear();
-	if (port->write("target-resume\n") == -1)
-		Util::panic();
+	transport->write("target-resume\n");
+	transport->flush();
 	return true;
 }
 
 bool Blackstrike::requestHalt()
 {
-	if (port->write("\003") == -1)
-		Util::panic();
+	transport->write("\003");
+	transport->flush();
 	return true;
 }
 
@@ -239,8 +249,12 @@ bool Blackstrike::syncFlash(const Memory &memory_contents)
 	int i;
 	QString s;
 	uint32_t total;
+	clearImmutableMemoryAreas();
 	if (memory_contents.isMemoryMatching(this))
+	{
+		enableImmutableMemoryAreas(memory_contents);
 		return true;
+	}
 	auto ranges = flashAreasForRange(memory_contents.ranges[0].address, memory_contents.ranges[0].data.size());
 	if (memory_contents.ranges.size() != 1 || ranges.empty())
 		Util::panic();
@@ -281,5 +295,8 @@ bool Blackstrike::syncFlash(const Memory &memory_contents)
 		Util::panic();
 	}
 	qDebug() << "flash write speed" << QString("%1 bytes per second").arg((float) (memory_contents.ranges[0].data.size() * 1000.) / t.elapsed());
-	return memory_contents.isMemoryMatching(this);
+	if (!memory_contents.isMemoryMatching(this))
+		return false;
+	enableImmutableMemoryAreas(memory_contents);
+	return true;
 }
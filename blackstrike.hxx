@@ -22,9 +22,9 @@ THE SOFTWARE.
 #ifndef BLACKSTRIKE_HXX
 #define BLACKSTRIKE_HXX
 
-#include <QSerialPort>
 #include <vector>
 #include "target.hxx"
+#include "probe-transport.hxx"
 #include "util.hxx"
 
 class Blackstrike : public Target
@@ -32,14 +32,20 @@ class Blackstrike : public Target
 	Q_OBJECT
 	std::vector<uint32_t>	registers;
 private:
-	QSerialPort	* port;
+	ProbeTransport	* transport;
 	void readAllRegisters(void);
 	QByteArray interrogate(const QByteArray &query, bool * isOk = 0);
 private slots:
-	void portReadyRead(void);
+	void transportDataReceived(void);
 public:
 	bool reset(void);
-	Blackstrike(QSerialPort * port) { this->port = port; }
+	/* takes ownership of the transport, which must already be open */
+	Blackstrike(ProbeTransport * transport)
+	{
+		this->transport = transport;
+		transport->setParent(this);
+		QObject::connect(transport, & ProbeTransport::connectionLost, [this] { emit targetHalted(TARGET_LOST); });
+	}
 	QByteArray readBytes(uint32_t address, int byte_count, bool is_failure_allowed = false);
 	uint32_t readWord(uint32_t address);
 	uint32_t readRawUncachedRegister(uint32_t register_number);
@@ -1,11 +1,13 @@
 #include "breakpoint-cache.hxx"
+#include "target.hxx"
 
 uint qHash(const BreakpointCache::SourceCodeBreakpoint & key)
-{ return qHash(key.source_filename) ^ qHash(key.directory_name) ^ qHash(key.compilation_directory) ^ qHash(key.line_number); }
+{ return qHash(qMakePair(key.sourceFileKey(), key.line_number)); }
 
 uint qHash(const BreakpointCache::MachineAddressBreakpoint & key) { return qHash(key.address); }
 
 const QString BreakpointCache::test_drive_base_directory = "troll-test-drive-files/";
+QHash<QString, int> BreakpointCache::source_file_keys;
 
 void BreakpointCache::updateBreakpointSets()
 {
@@ -47,4 +49,42 @@ int i, j;
 	}
 	disabledSourceCodeBreakpoints.subtract(enabledSourceCodeBreakpoints);
 	disabledMachineAddressBreakpoints.subtract(enabledMachineAddressBreakpoints);
+
+	machine_breakpoint_indices.clear();
+	source_breakpoint_indices.clear();
+	inferred_breakpoint_indices.clear();
+	enabled_breakpoint_lines.clear();
+	disabled_breakpoint_lines.clear();
+	/* Note: iterate in reverse order, so that the first matching breakpoint
+	 * index is found on lookups, as with the linear searches used previously */
+	for (i = sourceCodeBreakpoints.size() - 1; i >= 0; i --)
+		source_breakpoint_indices.insert(qMakePair(sourceCodeBreakpoints[i].sourceFileKey(), sourceCodeBreakpoints[i].line_number), i);
+	for (i = machineAddressBreakpoints.size() - 1; i >= 0; i --)
+	{
+		const MachineAddressBreakpoint & b(machineAddressBreakpoints[i]);
+		machine_breakpoint_indices.insert(b.address, i);
+		inferred_breakpoint_indices.insert(qMakePair(b.inferred_breakpoint.sourceFileKey(), b.inferred_breakpoint.line_number), i);
+	}
+	for (const auto & b : enabledSourceCodeBreakpoints)
+		enabled_breakpoint_lines[b.sourceFileKey()].push_back(b.line_number);
+	for (const auto & b : disabledSourceCodeBreakpoints)
+		disabled_breakpoint_lines[b.sourceFileKey()].push_back(b.line_number);
+}
+
+bool BreakpointCache::syncTargetBreakpoints(Target * target, const QSet<uint32_t> & wanted_breakpoints)
+{
+	/* remove breakpoints first, so that hardware breakpoint units get freed for the new breakpoints */
+	for (auto address : QSet<uint32_t>(installedMachineAddressBreakpoints).subtract(wanted_breakpoints))
+	{
+		if (!target->breakpointClear(address, 2))
+			qDebug() << "failed to remove breakpoint at address" << QString("$%1").arg(address, 8, 16, QChar('0'));
+		installedMachineAddressBreakpoints.remove(address);
+	}
+	for (auto address : QSet<uint32_t>(wanted_breakpoints).subtract(installedMachineAddressBreakpoints))
+	{
+		if (!target->breakpointSet(address, 2))
+			return false;
+		installedMachineAddressBreakpoints.insert(address);
+	}
+	return true;
 }
@@ -5,6 +5,8 @@
 #include <QVector>
 #include <QHash>
 #include <QDir>
+#include <QPair>
+#include <QRegExp>
 
 /*! \todo	this class gradually went quite braindamaged... maybe rework it */
 class BreakpointCache
@@ -12,59 +14,56 @@ class BreakpointCache
 private:
 	void updateBreakpointSets(void);
 	static const QString test_drive_base_directory;
+	/* canonical source file names, interned into source file keys */
+	static QHash<QString, int> source_file_keys;
+	/* Lookup indices, rebuilt whenever the breakpoints change. The source code line indices are
+	 * keyed by (source file key, line number) pairs */
+	QHash<uint32_t, int> machine_breakpoint_indices;
+	QHash<QPair<int, int>, int> source_breakpoint_indices, inferred_breakpoint_indices;
+	/* the line numbers of the enabled and disabled source code breakpoints, per source file key */
+	QHash<int, QVector<int> > enabled_breakpoint_lines, disabled_breakpoint_lines;
 public:
 	BreakpointCache(void){}
 
+	/* Returns an integer key for a source file. The key is the same for all file names that refer
+	 * to the same file (e.g., file names that only differ in the directory separators used) */
+	static int sourceFileKey(const QString & source_filename, const QString & directory_name, const QString & compilation_directory)
+	{
+		QString sname(source_filename), dirname(directory_name), cdir(compilation_directory);
+		if (TEST_DRIVE_MODE)
+		{
+			/* If running a test drive, the filenames should be adjusted. */
+			QRegExp rx("^[xX]:[/\\\\]");
+			sname.replace(rx, test_drive_base_directory);
+			dirname.replace(rx, test_drive_base_directory);
+			cdir.replace(rx, test_drive_base_directory);
+		}
+		auto canonical_name = QDir::toNativeSeparators(sname) + '\n' + QDir::toNativeSeparators(dirname) + '\n' + QDir::toNativeSeparators(cdir);
+		auto key = source_file_keys.constFind(canonical_name);
+		if (key != source_file_keys.constEnd())
+			return key.value();
+		int new_key = source_file_keys.size();
+		source_file_keys.insert(canonical_name, new_key);
+		return new_key;
+	}
+
 	struct SourceCodeBreakpoint
 	{
 		QString source_filename, directory_name, compilation_directory;
 		bool enabled;
 		int line_number;
 		QVector<uint32_t> addresses;
+		/* The source file key, computed once, when the breakpoint is added to the breakpoint cache. This is
+		 * not initialized here, so that this structure remains an aggregate; for breakpoints not added to
+		 * the breakpoint cache, use 'BreakpointCache::sourceFileKey(breakpoint)' instead */
+		int source_file_key;
+		int sourceFileKey(void) const { return source_file_key; }
 		bool operator == (const struct SourceCodeBreakpoint & other) const
-		{
-			if (TEST_DRIVE_MODE)
-			{
-				/* If running a test drive, the filenames should be adjusted. */
-				QRegExp rx("^[xX]:[/\\\\]");
-				struct SourceCodeBreakpoint b = other;
-				QString sname(source_filename), dirname(directory_name), cdir(compilation_directory);
-
-				return line_number == b.line_number
-						&& QDir::toNativeSeparators(sname.replace(rx, test_drive_base_directory)) == QDir::toNativeSeparators(b.source_filename.replace(rx, test_drive_base_directory))
-						&& QDir::toNativeSeparators(dirname.replace(rx, test_drive_base_directory)) == QDir::toNativeSeparators(b.directory_name.replace(rx, test_drive_base_directory))
-						&& QDir::toNativeSeparators(cdir.replace(rx, test_drive_base_directory)) == QDir::toNativeSeparators(b.compilation_directory.replace(rx, test_drive_base_directory));
-			}
-			else
-			{
-				return line_number == other.line_number && QDir::toNativeSeparators(source_filename) == QDir::toNativeSeparators(other.source_filename)
-						&& QDir::toNativeSeparators(directory_name) == QDir::toNativeSeparators(other.directory_name)
-						&& QDir::toNativeSeparators(compilation_directory) == QDir::toNativeSeparators(other.compilation_directory);
-			}
-		}
+		{ return line_number == other.line_number && sourceFileKey() == other.sourceFileKey(); }
 		/* returns -1 if the breakpoint is not inside the source code file */
+		int breakpointedLineNumberForSourceCode(int source_file_key) const { return sourceFileKey() == source_file_key ? line_number : -1; }
 		int breakpointedLineNumberForSourceCode(const QString & source_filename, const QString & directory_name, const QString & compilation_directory) const
-		{
-			if (TEST_DRIVE_MODE)
-			{
-				/* If running a test drive, the filenames should be adjusted. */
-				QRegExp rx("^[xX]:[/\\\\]");
-				QString sname(source_filename), dirname(directory_name), cdir(compilation_directory);
-				QString sname1(this->source_filename), dirname1(this->directory_name), cdir1(this->compilation_directory);
-
-				return (QDir::toNativeSeparators(sname.replace(rx, test_drive_base_directory)) == QDir::toNativeSeparators(sname.replace(rx, test_drive_base_directory))
-						&& QDir::toNativeSeparators(dirname.replace(rx, test_drive_base_directory)) == QDir::toNativeSeparators(dirname1.replace(rx, test_drive_base_directory))
-						&& QDir::toNativeSeparators(cdir.replace(rx, test_drive_base_directory)) == QDir::toNativeSeparators(cdir1.replace(rx, test_drive_base_directory)))
-						? line_number : -1;
-			}
-			else
-			{
-				return (QDir::toNativeSeparators(source_filename) == QDir::toNativeSeparators(this->source_filename)
-					&& QDir::toNativeSeparators(directory_name) == QDir::toNativeSeparators(this->directory_name)
-					&& QDir::toNativeSeparators(compilation_directory) == QDir::toNativeSeparators(this->compilation_directory))
-						? line_number : -1;
-			}
-		}
+		{ return breakpointedLineNumberForSourceCode(BreakpointCache::sourceFileKey(source_filename, directory_name, compilation_directory)); }
 	};
 	struct MachineAddressBreakpoint
 	{
@@ -77,39 +76,41 @@ public:
 	QVector<struct MachineAddressBreakpoint> machineAddressBreakpoints;
 	QVector<struct SourceCodeBreakpoint> sourceCodeBreakpoints;
 
-	int machineBreakpointIndex(uint32_t address)
-	{
-		int i;
-		for (i = 0; i < machineAddressBreakpoints.size(); i ++)
-			if (machineAddressBreakpoints[i].address == address)
-				return i;
-		return -1;
-	}
+	int machineBreakpointIndex(uint32_t address) { return machine_breakpoint_indices.value(address, -1); }
+	static int sourceFileKey(const struct SourceCodeBreakpoint & breakpoint)
+	{ return sourceFileKey(breakpoint.source_filename, breakpoint.directory_name, breakpoint.compilation_directory); }
+	/* the breakpoints passed to these need not have been added to the breakpoint cache */
 	int inferredBreakpointIndex(const struct SourceCodeBreakpoint & breakpoint)
-	{
-		int i;
-		for (i = 0; i < machineAddressBreakpoints.size(); i ++)
-			if (machineAddressBreakpoints[i].inferred_breakpoint == breakpoint)
-				return i;
-		return -1;
-	}
-
+	{ return inferred_breakpoint_indices.value(qMakePair(sourceFileKey(breakpoint), breakpoint.line_number), -1); }
 	int sourceBreakpointIndex(const struct SourceCodeBreakpoint & breakpoint)
-	{
-		int i;
-		for (i = 0; i < sourceCodeBreakpoints.size(); i ++)
-			if (sourceCodeBreakpoints[i] == breakpoint)
-				return i;
-		return -1;
-	}
+	{ return source_breakpoint_indices.value(qMakePair(sourceFileKey(breakpoint), breakpoint.line_number), -1); }
+	/* return the line numbers of the breakpoints in a source file */
+	QVector<int> enabledBreakpointLinesForSourceFile(int source_file_key) const { return enabled_breakpoint_lines.value(source_file_key); }
+	QVector<int> disabledBreakpointLinesForSourceFile(int source_file_key) const { return disabled_breakpoint_lines.value(source_file_key); }
 	
 	QSet<struct SourceCodeBreakpoint> enabledSourceCodeBreakpoints, disabledSourceCodeBreakpoints;
 	QSet<uint32_t> enabledMachineAddressBreakpoints, disabledMachineAddressBreakpoints;
+
+	/* The machine addresses at which breakpoints are currently installed on the target. Breakpoints
+	 * are left installed when the target halts, and when resuming or stepping the target, only
+	 * the differences between the installed, and the wanted breakpoints are sent to the target */
+	QSet<uint32_t> installedMachineAddressBreakpoints;
+	/* installs and removes breakpoints on the target, so that exactly the breakpoints in 'wanted_breakpoints'
+	 * are installed; returns false if a breakpoint could not be installed */
+	bool syncTargetBreakpoints(class Target * target, const QSet<uint32_t> & wanted_breakpoints);
+	/* must be called when the target is changed, or the connection to the target is lost */
+	void forgetInstalledBreakpoints(void) { installedMachineAddressBreakpoints.clear(); }
 	
-	void addSourceCodeBreakpoint(const struct SourceCodeBreakpoint & breakpoint) { sourceCodeBreakpoints.push_back(breakpoint); updateBreakpointSets(); }
+	void addSourceCodeBreakpoint(const struct SourceCodeBreakpoint & breakpoint)
+	{ sourceCodeBreakpoints.push_back(breakpoint); sourceCodeBreakpoints.last().source_file_key = sourceFileKey(breakpoint); updateBreakpointSets(); }
 	void removeSourceCodeBreakpointAtIndex(int breakpoint_index) { sourceCodeBreakpoints.removeAt(breakpoint_index); updateBreakpointSets(); }
 	int /* returns the index at which the breakpoint was placed */ addMachineAddressBreakpoint(const struct MachineAddressBreakpoint & breakpoint)
-	{ machineAddressBreakpoints.push_back(breakpoint); updateBreakpointSets(); return machineAddressBreakpoints.size() - 1; }
+	{
+		machineAddressBreakpoints.push_back(breakpoint);
+		machineAddressBreakpoints.last().inferred_breakpoint.source_file_key = sourceFileKey(breakpoint.inferred_breakpoint);
+		updateBreakpointSets();
+		return machineAddressBreakpoints.size() - 1;
+	}
 	void removeMachineAddressBreakpointAtIndex(int breakpoint_index) { machineAddressBreakpoints.removeAt(breakpoint_index); updateBreakpointSets(); }
 	
 	void toggleMachineBreakpointAtIndex(int breakpoint_index) { machineAddressBreakpoints[breakpoint_index].enabled = ! machineAddressBreakpoints[breakpoint_index].enabled; updateBreakpointSets(); }
@@ -21,6 +21,7 @@ THE SOFTWARE.
 */
 #include <QMessageBox>
 #include <QFile>
+#include <QDebug>
 
 #include "cortexm0.hxx"
 #include "target.hxx"
@@ -42,7 +43,10 @@ void do_target_fetch(void)
 	{
 		if (error == MEMORY_READ_ERROR)
 		{
-			QMessageBox::critical(0, "cannot read target memory", QString("failed to read memory at address $%1").arg(x.at(0), 8, 16, QChar('0')));
+			if (Util::isHeadless())
+				qDebug() << QString("failed to read memory at address $%1").arg(x.at(0), 8, 16, QChar('0'));
+			else
+				QMessageBox::critical(0, "cannot read target memory", QString("failed to read memory at address $%1").arg(x.at(0), 8, 16, QChar('0')));
 			do_abort();
 		}
 		Util::panic();
@@ -115,7 +119,8 @@ uint32_t cfa;
 	if (r.size() == 0)
 	{
 		/* evaluation probably aborted due to unsupported unwinding rules */
-		QMessageBox::critical(0, "register frame unwinding aborted", "register frame unwinding aborted\nsee the sforth execution log for more details");
+		if (!Util::isHeadless())
+			QMessageBox::critical(0, "register frame unwinding aborted", "register frame unwinding aborted\nsee the sforth execution log for more details");
 		return false;
 	}
         if (r.size() != 1 || r.at(0) != C_TRUE)
@@ -0,0 +1,280 @@
+/*
+Copyright (c) 2019 stoyan shopov
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QThread>
+#include <QThreadPool>
+#include <QRunnable>
+#include <QMutexLocker>
+#include <QJsonDocument>
+#include <QCryptographicHash>
+#include <QCommandLineParser>
+#include <QTime>
+#include <QDebug>
+
+#include "crash-triage.hxx"
+
+class CrashTriageTask : public QRunnable
+{
+private:
+	CrashTriage	* triage;
+	QString		core_dump;
+public:
+	CrashTriageTask(CrashTriage * triage, const QString & core_dump) { this->triage = triage, this->core_dump = core_dump; }
+	void run(void) { triage->triage(core_dump); }
+};
+
+CrashTriage::~CrashTriage()
+{
+	delete dwarf_evaluator;
+	delete cortexm0;
+	delete sforth;
+}
+
+bool CrashTriage::loadElf(const QString & elf_filename, QString & error_message)
+{
+	if (!debug_data.load(elf_filename, error_message))
+		return false;
+	if (!debug_data.dwundwind)
+		return error_message = "no '.debug_frame' section found in ELF file " + elf_filename, false;
+	debug_data.dwdata->reapStaticObjects(data_objects, subprograms);
+
+	sforth = new Sforth(sforthConsoleOutput);
+	/* the order of creating these is important, see the comments in the main window constructor */
+	cortexm0 = new CortexM0(sforth, 0, & register_cache);
+	dwarf_evaluator = new DwarfEvaluator(sforth, debug_data.dwdata, & register_cache);
+	return true;
+}
+
+/* Loads a core dump - either an ELF core file, or a snapshot manifest file, or a directory containing either a
+ * 'core.manifest' file, or the 'flash.bin', 'ram.bin' and 'registers.bin' files saved by the troll */
+Target * CrashTriage::loadCoreDump(const QString & core_dump, QString & error_message)
+{
+	QFileInfo f(core_dump);
+	if (!f.isDir())
+		return TargetCorefile::load(core_dump, & error_message);
+	QDir dir(core_dump);
+	if (dir.exists("core.manifest"))
+		return TargetCorefile::load(dir.filePath("core.manifest"), & error_message);
+	if (!dir.exists("registers.bin"))
+		return error_message = "no core dump found in directory " + core_dump, (Target *) 0;
+	return new TargetCorefile(dir.filePath("flash.bin"), 0x08000000, dir.filePath("ram.bin"), 0x20000000, dir.filePath("registers.bin"));
+}
+
+void CrashTriage::output(const QJsonObject & result)
+{
+	QMutexLocker locker(& output_mutex);
+	fputs(QJsonDocument(result).toJson(QJsonDocument::Compact).append('\n').constData(), stdout);
+	fflush(stdout);
+}
+
+void CrashTriage::triage(const QString & core_dump)
+{
+	QJsonObject result;
+	QString error_message;
+	Target * target = loadCoreDump(core_dump, error_message);
+	QVector<struct frame> frames;
+	QJsonArray locals;
+	int i;
+
+	result["dump"] = core_dump;
+	if (!target)
+	{
+		result["error"] = error_message;
+		output(result);
+		return;
+	}
+
+	{
+		QMutexLocker locker(& engine_mutex);
+		try
+		{
+			cortexm0->setTargetController(target);
+			cortexm0->primeUnwinder();
+			register_cache.clear();
+			register_cache.pushFrame(cortexm0->getRegisters());
+			uint32_t last_pc = cortexm0->programCounter(), last_stack_pointer = cortexm0->stackPointerValue();
+			auto context = debug_data.dwdata->executionContextForAddress(last_pc);
+			do
+			{
+				struct frame f = { .program_counter = cortexm0->programCounter(), .function = QString(), .file = QString(), .line = -1, .inlining_chain = QStringList(), };
+				auto locations = debug_data.symbolize(f.program_counter, context,
+								      context.empty() ? SourceCodeCoordinates() : debug_data.dwdata->sourceCodeCoordinatesForAddress(f.program_counter));
+				/* the last location is in the function that is not inlined anywhere, list the inlined functions outermost first */
+				f.function = locations.last().function;
+				f.file = locations.first().file, f.line = locations.first().line;
+				for (i = locations.size() - 2; i >= 0; i --)
+					f.inlining_chain << locations.at(i).function;
+				frames << f;
+				if (context.empty())
+					break;
+				auto unwind_data = debug_data.dwundwind->sforthCodeForAddress(f.program_counter);
+				if (cortexm0->unwindFrame(QString::fromStdString(unwind_data.first), unwind_data.second, f.program_counter))
+					context = debug_data.dwdata->executionContextForAddress(cortexm0->programCounter() - 1), register_cache.pushFrame(cortexm0->getRegisters());
+				if (context.empty() && cortexm0->architecturalUnwind())
+				{
+					context = debug_data.dwdata->executionContextForAddress(cortexm0->programCounter());
+					if (!context.empty())
+						register_cache.pushFrame(cortexm0->getRegisters());
+				}
+				if (last_pc == cortexm0->programCounter() && last_stack_pointer == cortexm0->stackPointerValue())
+					break;
+				last_pc = cortexm0->programCounter();
+				last_stack_pointer = cortexm0->stackPointerValue();
+			}
+			while (frames.size() < MAX_BACKTRACE_FRAME_COUNT);
+
+			/* evaluate the local data objects of the innermost frame */
+			register_cache.setActiveFrame(0);
+			uint32_t pc = frames.at(0).program_counter, cfa_value = (register_cache.frameCount() > 1) ? register_cache.readCachedRegister(/*! \todo fix this! don't hardcode it! */13, 1) : -1;
+			context = debug_data.dwdata->executionContextForAddress(pc);
+			if (!context.empty())
+			{
+				QString frame_base_sforth_code = QString::fromStdString(debug_data.dwdata->sforthCodeFrameBaseForContext(context, pc));
+				for (const auto & local : debug_data.dwdata->localDataObjectsForContext(context))
+				{
+					std::vector<struct DwarfTypeNode> type_cache;
+					debug_data.dwdata->readType(local.offset, type_cache);
+					int size = debug_data.dwdata->sizeOf(type_cache);
+					auto location = dwarf_evaluator->evaluateLocation(cfa_value, frame_base_sforth_code,
+											   QString::fromStdString(debug_data.dwdata->locationSforthCode(local, context.at(0), pc)));
+					QJsonObject x;
+					x["name"] = QString(debug_data.dwdata->nameOfDie(local));
+					x["size"] = size;
+					if (location.type == DwarfEvaluator::DwarfExpressionValue::INVALID || size <= 0)
+						x["value"] = QJsonValue::Null;
+					else
+						x["value"] = QString(DwarfEvaluator::fetchValueFromTarget(location, target, size));
+					locals.append(x);
+				}
+			}
+		}
+		catch (enum TARGET_ERROR_ENUM error)
+		{
+			result["error"] = "target memory read error while unwinding";
+		}
+	}
+
+	QJsonArray backtrace, globals;
+	QStringList signature;
+	for (const auto & f : frames)
+	{
+		QJsonObject x;
+		x["pc"] = QString("0x%1").arg(f.program_counter, 8, 16, QChar('0'));
+		x["function"] = f.function;
+		if (!f.file.isEmpty())
+			x["file"] = f.file, x["line"] = f.line;
+		if (!f.inlining_chain.isEmpty())
+			x["inlined"] = QJsonArray::fromStringList(f.inlining_chain);
+		backtrace.append(x);
+		if (signature.size() < STACK_SIGNATURE_FRAME_COUNT)
+			signature << (f.function.isEmpty() ? QString("0x%1").arg(f.program_counter, 8, 16, QChar('0')) : f.function);
+	}
+	for (const auto & object : watched_static_objects)
+	{
+		QJsonObject x;
+		QByteArray data = target->readBytes(object.address, object.size, true);
+		x["name"] = object.name;
+		x["address"] = QString("0x%1").arg(object.address, 8, 16, QChar('0'));
+		x["value"] = data.size() == object.size ? QJsonValue(QString(data.toHex())) : QJsonValue::Null;
+		globals.append(x);
+	}
+	QString stack_signature = signature.join(" < ");
+	result["backtrace"] = backtrace;
+	result["locals"] = locals;
+	if (!globals.isEmpty())
+		result["globals"] = globals;
+	result["signature"] = stack_signature;
+	result["bucket"] = QString(QCryptographicHash::hash(stack_signature.toUtf8(), QCryptographicHash::Sha1).toHex().left(12));
+	delete target;
+
+	output(result);
+	QMutexLocker locker(& output_mutex);
+	buckets[stack_signature] << core_dump;
+}
+
+int CrashTriage::run(const QStringList & arguments)
+{
+	QCommandLineParser parser;
+	QCommandLineOption triage_option("triage", "Triage core dumps, without starting the graphical user interface."),
+			jobs_option(QStringList() << "j" << "jobs", "Number of worker threads.", "count", QString("%1").arg(QThread::idealThreadCount())),
+			global_option(QStringList() << "g" << "global", "Static data object to report for each core dump; may be repeated.", "name");
+	QString error_message;
+	CrashTriage triage;
+	QTime t;
+	int i;
+
+	parser.setApplicationDescription("troll crash triage - examines a batch of target core dumps, and writes the results as JSON lines to the standard output");
+	parser.addHelpOption();
+	parser.addOption(triage_option);
+	parser.addOption(jobs_option);
+	parser.addOption(global_option);
+	parser.addPositionalArgument("elf-file", "The ELF file of the program that generated the core dumps.");
+	parser.addPositionalArgument("core-dumps", "ELF core files, snapshot manifest files, or core dump directories.", "core-dumps...");
+	parser.process(arguments);
+
+	auto positional_arguments = parser.positionalArguments();
+	if (positional_arguments.size() < 2)
+		parser.showHelp(1);
+	t.start();
+	if (!triage.loadElf(positional_arguments.at(0), error_message))
+	{
+		fprintf(stderr, "%s\n", error_message.toLocal8Bit().constData());
+		return 1;
+	}
+	for (const auto & name : parser.values(global_option))
+	{
+		for (i = 0; i < triage.data_objects.size(); i ++)
+			if (triage.data_objects.at(i).name && name == triage.data_objects.at(i).name)
+				break;
+		if (i == triage.data_objects.size())
+		{
+			fprintf(stderr, "static data object '%s' not found\n", name.toLocal8Bit().constData());
+			return 1;
+		}
+		std::vector<struct DwarfTypeNode> type_cache;
+		triage.debug_data.dwdata->readType(triage.data_objects.at(i).die_offset, type_cache);
+		triage.watched_static_objects.push_back((struct static_object) { .name = name, .address = triage.data_objects.at(i).address,
+				.size = triage.debug_data.dwdata->sizeOf(type_cache, 1), });
+	}
+	qDebug() << "ELF file loaded in" << t.elapsed() << "milliseconds";
+
+	t.restart();
+	QThreadPool pool;
+	pool.setMaxThreadCount(Util::max(parser.value(jobs_option).toInt(), 1));
+	for (i = 1; i < positional_arguments.size(); i ++)
+		pool.start(new CrashTriageTask(& triage, positional_arguments.at(i)));
+	pool.waitForDone();
+
+	for (auto bucket = triage.buckets.cbegin(); bucket != triage.buckets.cend(); bucket ++)
+	{
+		QJsonObject x;
+		x["bucket"] = QString(QCryptographicHash::hash(bucket.key().toUtf8(), QCryptographicHash::Sha1).toHex().left(12));
+		x["signature"] = bucket.key();
+		x["count"] = bucket.value().size();
+		x["dumps"] = QJsonArray::fromStringList(bucket.value());
+		triage.output(x);
+	}
+	qDebug() << positional_arguments.size() - 1 << "core dumps triaged in" << t.elapsed() << "milliseconds";
+	return 0;
+}
@@ -0,0 +1,105 @@
+/*
+Copyright (c) 2019 stoyan shopov
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+#ifndef CRASHTRIAGE_HXX
+#define CRASHTRIAGE_HXX
+
+#include <QString>
+#include <QStringList>
+#include <QByteArray>
+#include <QMap>
+#include <QVector>
+#include <QHash>
+#include <QMutex>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <stdio.h>
+
+#include "elf-debug-data.hxx"
+#include "sforth.hxx"
+#include "cortexm0.hxx"
+#include "dwarf-evaluator.hxx"
+#include "registercache.hxx"
+#include "target-corefile.hxx"
+#include "util.hxx"
+
+/* Headless batch triage of target core dumps. The ELF file and its debug information are loaded and indexed
+ * once, and then any number of core dumps are examined in parallel, by a pool of worker threads. For each core
+ * dump, a JSON object, on a single line, is written to the standard output, containing the backtrace, the local
+ * data objects of the innermost frame, and any requested static data objects. The core dumps are also bucketed
+ * by their stack signatures (the names of the innermost functions in the backtrace), and after all core dumps
+ * have been processed, one JSON line for each bucket is written to the standard output.
+ *
+ * The sforth engine, which runs the unwinder and the DWARF expression evaluator, is a single global instance, and the
+ * DWARF data queries are not thread safe, so backtrace generation and DWARF queries are serialized; loading core
+ * dumps, reading data object contents, and formatting the results are done in parallel */
+class CrashTriage
+{
+private:
+	enum
+	{
+		/* the number of innermost frames used for building the stack signature of a core dump */
+		STACK_SIGNATURE_FRAME_COUNT	= 5,
+		/* guard against corrupt stacks */
+		MAX_BACKTRACE_FRAME_COUNT	= 64,
+	};
+	ElfDebugData	debug_data;
+	Sforth		* sforth = 0;
+	CortexM0	* cortexm0 = 0;
+	DwarfEvaluator	* dwarf_evaluator = 0;
+	RegisterCache	register_cache;
+	std::vector<struct StaticObject> data_objects, subprograms;
+
+	/* serializes all accesses to the sforth engine and to the DWARF data */
+	QMutex	engine_mutex;
+	QMutex	output_mutex;
+	QMap<QString /* stack signature */, QStringList /* core dumps */> buckets;
+
+	struct static_object
+	{
+		QString		name;
+		uint32_t	address;
+		int		size;
+	};
+	QVector<struct static_object> watched_static_objects;
+
+	struct frame
+	{
+		uint32_t	program_counter;
+		QString		function;
+		QString		file;
+		int		line;
+		QStringList	inlining_chain;
+	};
+
+	static void sforthConsoleOutput(const QString & console_output) {}
+	bool loadElf(const QString & elf_filename, QString & error_message);
+	Target * loadCoreDump(const QString & core_dump, QString & error_message);
+	void triage(const QString & core_dump);
+	void output(const QJsonObject & result);
+	friend class CrashTriageTask;
+public:
+	~CrashTriage();
+	/* Runs the crash triage, with the command line arguments passed; returns the process exit code */
+	static int run(const QStringList & arguments);
+};
+
+#endif // CRASHTRIAGE_HXX
@@ -0,0 +1,73 @@
+/*
+Copyright (c) 2019 stoyan shopov
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+#ifndef CRC32_HXX
+#define CRC32_HXX
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* CRC-32 as used by the gdb remote serial protocol 'qCRC' packet - polynomial 0x04c11db7,
+ * processed most significant bit first (i.e., not reflected), initial value 0xffffffff, and
+ * no final inversion. This is computed with a table-driven, slicing-by-4 implementation,
+ * which processes four bytes per iteration */
+class Crc32
+{
+private:
+	enum { POLYNOMIAL = 0x04c11db7, };
+	struct Tables
+	{
+		uint32_t t[4][256];
+		Tables(void)
+		{
+			int i, j;
+			for (i = 0; i < 256; i ++)
+			{
+				uint32_t crc = i << 24;
+				for (j = 0; j < 8; j ++)
+					crc = (crc & 0x80000000) ? (crc << 1) ^ POLYNOMIAL : crc << 1;
+				t[0][i] = crc;
+			}
+			for (i = 0; i < 256; i ++)
+				for (j = 1; j < 4; j ++)
+					t[j][i] = (t[j - 1][i] << 8) ^ t[0][t[j - 1][i] >> 24];
+		}
+	};
+	static const Tables & tables(void) { static const Tables tables; return tables; }
+public:
+	enum { INITIAL_VALUE = 0xffffffff, };
+	/* the 'crc' parameter can be used for computing the crc of data in several pieces */
+	static uint32_t crc32(const void * data, size_t length, uint32_t crc = INITIAL_VALUE)
+	{
+		auto & t = tables().t;
+		auto p = (const uint8_t *) data;
+		for (; length >= 4; length -= 4, p += 4)
+		{
+			crc ^= (p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+			crc = t[3][crc >> 24] ^ t[2][(crc >> 16) & 0xff] ^ t[1][(crc >> 8) & 0xff] ^ t[0][crc & 0xff];
+		}
+		while (length --)
+			crc = (crc << 8) ^ t[0][(crc >> 24) ^ * p ++];
+		return crc;
+	}
+};
+
+#endif // CRC32_HXX
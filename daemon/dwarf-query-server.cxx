@@ -0,0 +1,331 @@
+/*
+Copyright (c) 2019 stoyan shopov
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+#include <QFile>
+#include <QFileInfo>
+#include <QCryptographicHash>
+#include <QJsonDocument>
+#include <QTime>
+#include <QDebug>
+
+#include "dwarf-query-server.hxx"
+
+DwarfQueryServer::DwarfQueryServer(const QString & server_name)
+{
+	/* Remove any stale socket, left behind by a server that did not shut down properly - but do not
+	 * take over the socket of a server that is still running */
+	QLocalSocket s;
+	s.connectToServer(server_name);
+	if (s.waitForConnected(SERVER_PROBE_TIMEOUT_MS))
+	{
+		s.disconnectFromServer();
+		qDebug() << "another server is already listening on" << server_name;
+		return;
+	}
+	QLocalServer::removeServer(server_name);
+	if (!server.listen(server_name))
+		return;
+	connect(& server, SIGNAL(newConnection()), this, SLOT(newConnection()));
+}
+
+DwarfQueryServer::~DwarfQueryServer()
+{
+	qDeleteAll(sessions);
+}
+
+struct DwarfQueryServer::Session * DwarfQueryServer::openSession(const QString & elf_filename, QByteArray & session_id, bool & is_cached, QString & error_message)
+{
+	QFileInfo file_info(elf_filename);
+	auto h = file_hashes.constFind(file_info.absoluteFilePath());
+	if (h != file_hashes.constEnd() && file_info.exists()
+			&& h.value().size == file_info.size() && h.value().last_modified == file_info.lastModified())
+		session_id = h.value().session_id;
+	else
+	{
+		QFile f(elf_filename);
+		if (!f.open(QFile::ReadOnly))
+			return error_message = "cannot open ELF file " + elf_filename, (struct Session *) 0;
+		QCryptographicHash sha1(QCryptographicHash::Sha1);
+		sha1.addData(& f);
+		session_id = sha1.result().toHex();
+		file_hashes.insert(file_info.absoluteFilePath(),
+				   (struct file_hash) { .size = file_info.size(), .last_modified = file_info.lastModified(), .session_id = session_id, });
+	}
+	if ((is_cached = sessions.contains(session_id)))
+		return markSessionUsed(session_id), sessions.value(session_id);
+
+	QTime t;
+	t.start();
+	struct Session * session = new Session;
+	int i;
+	session->elf_filename = QFileInfo(elf_filename).absoluteFilePath();
+	if (!session->load(elf_filename, error_message))
+		return delete session, (struct Session *) 0;
+	session->dwdata->reapStaticObjects(session->data_objects, session->subprograms);
+	for (i = 0; i < session->data_objects.size(); i ++)
+		if (session->data_objects.at(i).name && !session->data_object_indices.contains(session->data_objects.at(i).name))
+			session->data_object_indices.insert(session->data_objects.at(i).name, i);
+	sessions.insert(session_id, session);
+	markSessionUsed(session_id);
+	qDebug() << "loaded" << session->elf_filename << "in" << t.elapsed() << "milliseconds, session" << session_id;
+	evictSessions();
+	return session;
+}
+
+void DwarfQueryServer::evictSessions(void)
+{
+	while (sessions.size() > max_session_count)
+	{
+		auto session_id = session_use_order.takeFirst();
+		auto session = sessions.take(session_id);
+		qDebug() << "unloading" << session->elf_filename << ", session" << session_id;
+		delete session;
+		for (auto h = file_hashes.begin(); h != file_hashes.end();)
+			if (h.value().session_id == session_id)
+				h = file_hashes.erase(h);
+			else
+				h ++;
+	}
+}
+
+bool DwarfQueryServer::preload(const QString & elf_filename)
+{
+	QByteArray session_id;
+	QString error_message;
+	bool is_cached;
+	if (openSession(elf_filename, session_id, is_cached, error_message))
+		return true;
+	qDebug() << error_message;
+	return false;
+}
+
+bool DwarfQueryServer::addressValue(const QJsonValue & value, uint32_t & address)
+{
+	bool ok = false;
+	double x;
+	if (value.isDouble())
+	{
+		if ((x = value.toDouble()) < 0 || x > 0xffffffffu || x != (double) (uint64_t) x)
+			return false;
+		return address = x, true;
+	}
+	if (value.isString())
+		address = value.toString().toUInt(& ok, 0);
+	return ok;
+}
+
+QJsonObject DwarfQueryServer::symbolize(struct Session * session, const QJsonArray & addresses)
+{
+	QJsonObject response;
+	QJsonArray results;
+	std::vector<uint32_t> x;
+	uint32_t address;
+	int i, j;
+
+	for (i = 0; i < addresses.size(); i ++)
+		if (!addressValue(addresses.at(i), address))
+			return response["error"] = "invalid address", response;
+		else
+			x.push_back(address);
+	auto contexts = session->dwdata->executionContextsForAddresses(x);
+	auto coordinates = session->dwdata->sourceCodeCoordinatesForAddresses(x);
+	for (i = 0; i < x.size(); i ++)
+	{
+		QJsonObject result;
+		QJsonArray inlined_by;
+		auto locations = session->symbolize(x.at(i), contexts.at(i), coordinates.at(i));
+		for (j = 0; j < locations.size(); j ++)
+		{
+			QJsonObject location;
+			location["function"] = locations.at(j).function;
+			if (locations.at(j).line != -1)
+				location["file"] = locations.at(j).file, location["line"] = locations.at(j).line;
+			/* the innermost function, followed by the functions it is inlined in */
+			if (!j)
+				result = location, result["address"] = hexAddress(x.at(i));
+			else
+				inlined_by.append(location);
+		}
+		if (!inlined_by.isEmpty())
+			result["inlined_by"] = inlined_by;
+		results.append(result);
+	}
+	response["results"] = results;
+	return response;
+}
+
+QJsonObject DwarfQueryServer::layoutOfNode(const DwarfData::DataNode & node)
+{
+	QJsonObject layout;
+	QJsonArray children;
+	layout["name"] = node.data.empty() ? QString() : QString::fromStdString(node.data.at(0));
+	layout["size"] = (int) node.bytesize;
+	layout["offset"] = (int) node.data_member_location;
+	if (node.bitsize)
+		layout["bitsize"] = (int) node.bitsize, layout["bitposition"] = (int) node.bitposition;
+	if (node.is_pointer)
+		layout["is_pointer"] = true;
+	for (const auto & child : node.children)
+		children.append(layoutOfNode(child));
+	if (!children.isEmpty())
+		layout["children"] = children;
+	return layout;
+}
+
+QJsonObject DwarfQueryServer::typeLayout(struct Session * session, const QString & object_name)
+{
+	QJsonObject response;
+	auto i = session->data_object_indices.constFind(object_name);
+	if (i == session->data_object_indices.cend())
+		return response["error"] = "static data object not found: " + object_name, response;
+	const struct StaticObject & object(session->data_objects.at(i.value()));
+	std::vector<struct DwarfTypeNode> type_cache;
+	struct DwarfData::DataNode node;
+	session->dwdata->readType(object.die_offset, type_cache);
+	session->dwdata->dataForType(type_cache, node, 1);
+	response["address"] = hexAddress(object.address);
+	response["type"] = QString::fromStdString(session->dwdata->typeString(type_cache, 1));
+	response["layout"] = layoutOfNode(node);
+	return response;
+}
+
+QJsonObject DwarfQueryServer::localsPlan(struct Session * session, uint32_t address)
+{
+	QJsonObject response;
+	QJsonArray locals;
+	auto context = session->dwdata->executionContextForAddress(address);
+	if (context.empty())
+		return response["error"] = "no debug information for address " + hexAddress(address), response;
+	for (const auto & die : context)
+		if (die.isNonInlinedSubprogram())
+		{
+			response["function"] = QString(session->dwdata->nameOfDie(die));
+			break;
+		}
+	response["frame_base"] = QString::fromStdString(session->dwdata->sforthCodeFrameBaseForContext(context, address));
+	for (const auto & local : session->dwdata->localDataObjectsForContext(context))
+	{
+		QJsonObject x;
+		std::vector<struct DwarfTypeNode> type_cache;
+		session->dwdata->readType(local.offset, type_cache);
+		x["name"] = QString(session->dwdata->nameOfDie(local));
+		x["type"] = QString::fromStdString(session->dwdata->typeString(type_cache, 1));
+		x["size"] = session->dwdata->sizeOf(type_cache);
+		x["location"] = QString::fromStdString(session->dwdata->locationSforthCode(local, context.at(0), address));
+		locals.append(x);
+	}
+	response["locals"] = locals;
+	return response;
+}
+
+QJsonObject DwarfQueryServer::unwindRules(struct Session * session, uint32_t address)
+{
+	QJsonObject response;
+	if (!session->dwundwind)
+		return response["error"] = "no unwind information in ELF file " + session->elf_filename, response;
+	auto unwind_data = session->dwundwind->sforthCodeForAddress(address);
+	if (unwind_data.second == -1)
+		return response["error"] = "no unwind information for address " + hexAddress(address), response;
+	response["code"] = QString::fromStdString(unwind_data.first);
+	response["start_address"] = hexAddress(unwind_data.second);
+	return response;
+}
+
+QJsonObject DwarfQueryServer::handleRequest(const QJsonObject & request)
+{
+	QJsonObject response;
+	QString op = request["op"].toString(), error_message;
+	QByteArray session_id;
+	struct Session * session = 0;
+	uint32_t address;
+	bool is_cached;
+
+	if (op == "open")
+	{
+		if (!(session = openSession(request["elf"].toString(), session_id, is_cached, error_message)))
+			return response["error"] = error_message, response;
+		response["session"] = QString(session_id);
+		response["cached"] = is_cached;
+		return response;
+	}
+	if (!(session = sessions.value(request["session"].toString().toLatin1(), 0)))
+		return response["error"] = "unknown session", response;
+	markSessionUsed(request["session"].toString().toLatin1());
+	if (op == "symbolize")
+		return symbolize(session, request["addresses"].toArray());
+	if (op == "type_layout")
+		return typeLayout(session, request["object"].toString());
+	if (op != "locals_plan" && op != "unwind_rules")
+		return response["error"] = "unknown request: " + op, response;
+	if (!addressValue(request["address"], address))
+		return response["error"] = "invalid address", response;
+	return op == "locals_plan" ? localsPlan(session, address) : unwindRules(session, address);
+}
+
+void DwarfQueryServer::newConnection(void)
+{
+	QLocalSocket * s;
+	while ((s = server.nextPendingConnection()))
+	{
+		connect(s, SIGNAL(readyRead()), this, SLOT(clientReadyRead()));
+		connect(s, SIGNAL(disconnected()), this, SLOT(clientDisconnected()));
+	}
+}
+
+void DwarfQueryServer::clientReadyRead(void)
+{
+	QLocalSocket * s = qobject_cast<QLocalSocket *>(sender());
+	QByteArray & input(client_input[s]);
+	int i;
+	input += s->readAll();
+	while ((i = input.indexOf('\n')) != -1)
+	{
+		QJsonParseError error;
+		QJsonObject response;
+		QJsonDocument request = QJsonDocument::fromJson(input.left(i), & error);
+		input.remove(0, i + 1);
+		if (!request.isObject())
+			response["error"] = "malformed request: " + error.errorString();
+		else
+		{
+			response = handleRequest(request.object());
+			if (request.object().contains("id"))
+				response["id"] = request.object()["id"];
+		}
+		s->write(QJsonDocument(response).toJson(QJsonDocument::Compact).append('\n'));
+	}
+	if (input.size() > MAX_REQUEST_LENGTH)
+	{
+		QJsonObject response;
+		response["error"] = "request too long";
+		/* the disconnection may delete the input buffer, so clear it first */
+		input.clear();
+		s->write(QJsonDocument(response).toJson(QJsonDocument::Compact).append('\n'));
+		s->disconnectFromServer();
+	}
+}
+
+void DwarfQueryServer::clientDisconnected(void)
+{
+	QLocalSocket * s = qobject_cast<QLocalSocket *>(sender());
+	client_input.remove(s);
+	s->deleteLater();
+}
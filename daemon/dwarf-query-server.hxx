@@ -0,0 +1,133 @@
+/*
+Copyright (c) 2019 stoyan shopov
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+#ifndef DWARFQUERYSERVER_HXX
+#define DWARFQUERYSERVER_HXX
+
+#include <QObject>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QHash>
+#include <QList>
+#include <QDateTime>
+#include <QByteArray>
+#include <QJsonObject>
+#include <QJsonArray>
+
+#include "elf-debug-data.hxx"
+#include "util.hxx"
+
+/* A long-lived server, that keeps the parsed and indexed debug information of ELF files resident, and answers
+ * queries about it over a local socket (a unix domain socket, on unix systems). The debug information of an ELF
+ * file is loaded once, when a client first opens the ELF file, and is then shared by all clients that open an
+ * ELF file with the same contents - ELF files are identified by the SHA-1 hash of their contents, so that the
+ * same build, copied to different locations, is only loaded once. The hash of an ELF file is only computed again
+ * if the size or the modification time of the file changes. At most a maximum number of ELF files are kept loaded;
+ * when another ELF file is opened, the least recently used one is unloaded, and clients using it get "unknown
+ * session" errors, and must open the ELF file again.
+ *
+ * The protocol is line based - each request and response is a JSON object on a single line. Requests contain
+ * an "op" field naming the query, and optionally an "id" field, that is copied verbatim in the response.
+ * Failed requests get a response with an "error" field. Queries:
+ *	{"op":"open","elf":"<ELF file name>"}
+ *		-> {"session":"<SHA-1 of the ELF file>","cached":<true if the ELF file was already loaded>}
+ *	{"op":"symbolize","session":"...","addresses":[<address>...]}
+ *		-> {"results":[{"address","function","file","line","inlined_by":[{"function","file","line"}...]}...]}
+ *	{"op":"type_layout","session":"...","object":"<static data object name>"}
+ *		-> {"address","type","layout":{"name","size","offset","bitsize","bitposition","is_pointer","children":[...]}}
+ *	{"op":"locals_plan","session":"...","address":<address>}
+ *		-> {"function","frame_base","locals":[{"name","type","size","location"}...]}
+ *	{"op":"unwind_rules","session":"...","address":<address>}
+ *		-> {"code","start_address"}
+ * Addresses can be either JSON numbers, or strings containing hexadecimal ("0x" prefixed) or decimal numbers.
+ * Location, frame base and unwind rules are returned as the sforth code that the troll evaluates for them.
+ *
+ * All queries are answered from the thread running the Qt event loop, because the DWARF data queries are not
+ * thread safe */
+class DwarfQueryServer : public QObject
+{
+	Q_OBJECT
+public:
+	enum
+	{
+		/* default maximum number of ELF files kept loaded */
+		DEFAULT_MAX_SESSION_COUNT	= 16,
+	};
+	DwarfQueryServer(const QString & server_name);
+	~DwarfQueryServer();
+	bool isListening(void) { return server.isListening(); }
+	QString fullServerName(void) { return server.fullServerName(); }
+	QString errorString(void) { return server.errorString(); }
+	/* Loads the debug information of an ELF file in advance, so that even the first client opening it gets an immediate answer */
+	bool preload(const QString & elf_filename);
+	/* sets the maximum number of ELF files kept loaded; must be called before preloading ELF files */
+	void setMaxSessionCount(int count) { max_session_count = Util::max(count, 1); }
+
+private:
+	enum
+	{
+		/* time to wait for another server, already listening on the same socket name, to answer */
+		SERVER_PROBE_TIMEOUT_MS		= 200,
+		/* clients sending longer requests are disconnected, so that a misbehaving client cannot
+		 * exhaust the memory of the server, which is shared by all clients */
+		MAX_REQUEST_LENGTH		= 16 * 1024 * 1024,
+	};
+	struct Session : public ElfDebugData
+	{
+		QString		elf_filename;
+		std::vector<struct StaticObject> data_objects, subprograms;
+		QHash<QString, int> data_object_indices;
+	};
+	QLocalServer	server;
+	QHash<QByteArray /* SHA-1 of the ELF file contents, in hex */, struct Session *> sessions;
+	/* session identifiers, least recently used first */
+	QList<QByteArray> session_use_order;
+	int max_session_count = DEFAULT_MAX_SESSION_COUNT;
+	/* the hashes of the contents of the ELF files opened, keyed by absolute file name */
+	struct file_hash
+	{
+		qint64		size;
+		QDateTime	last_modified;
+		QByteArray	session_id;
+	};
+	QHash<QString, struct file_hash> file_hashes;
+	/* incomplete request lines received from clients */
+	QHash<QLocalSocket *, QByteArray> client_input;
+
+	struct Session * openSession(const QString & elf_filename, QByteArray & session_id, bool & is_cached, QString & error_message);
+	void markSessionUsed(const QByteArray & session_id) { session_use_order.removeOne(session_id); session_use_order.append(session_id); }
+	/* unloads the least recently used sessions, while there are more than the maximum number of sessions */
+	void evictSessions(void);
+	QJsonObject handleRequest(const QJsonObject & request);
+	QJsonObject symbolize(struct Session * session, const QJsonArray & addresses);
+	QJsonObject typeLayout(struct Session * session, const QString & object_name);
+	QJsonObject localsPlan(struct Session * session, uint32_t address);
+	QJsonObject unwindRules(struct Session * session, uint32_t address);
+	static QJsonObject layoutOfNode(const DwarfData::DataNode & node);
+	static bool addressValue(const QJsonValue & value, uint32_t & address);
+	static QString hexAddress(uint32_t address) { return QString("0x%1").arg(address, 8, 16, QChar('0')); }
+private slots:
+	void newConnection(void);
+	void clientReadyRead(void);
+	void clientDisconnected(void);
+};
+
+#endif // DWARFQUERYSERVER_HXX
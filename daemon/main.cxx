@@ -0,0 +1,57 @@
+/*
+Copyright (c) 2019 stoyan shopov
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <stdio.h>
+
+#include "dwarf-query-server.hxx"
+
+int main(int argc, char *argv[])
+{
+	QCoreApplication a(argc, argv);
+	QCommandLineParser parser;
+	QCommandLineOption server_name_option(QStringList() << "n" << "name", "Name of the local socket to listen on.", "name", "trolld");
+	QCommandLineOption preload_option(QStringList() << "p" << "preload", "ELF file to load at startup; may be repeated.", "elf-file");
+	QCommandLineOption max_sessions_option(QStringList() << "m" << "max-sessions", "Maximum number of ELF files kept loaded; the least recently used ones are unloaded.",
+					       "count", QString::number(DwarfQueryServer::DEFAULT_MAX_SESSION_COUNT));
+
+	parser.setApplicationDescription("trolld - serves DWARF debug information queries over a local socket");
+	parser.addHelpOption();
+	parser.addOption(server_name_option);
+	parser.addOption(preload_option);
+	parser.addOption(max_sessions_option);
+	parser.process(a);
+
+	DwarfQueryServer server(parser.value(server_name_option));
+	if (!server.isListening())
+	{
+		fprintf(stderr, "cannot listen on local socket %s: %s\n", parser.value(server_name_option).toLocal8Bit().constData(),
+			server.errorString().toLocal8Bit().constData());
+		return 1;
+	}
+	server.setMaxSessionCount(parser.value(max_sessions_option).toInt());
+	for (const auto & elf_filename : parser.values(preload_option))
+		if (!server.preload(elf_filename))
+			return 1;
+	fprintf(stderr, "listening on %s\n", server.fullServerName().toLocal8Bit().constData());
+	return a.exec();
+}
@@ -0,0 +1,33 @@
+#-------------------------------------------------
+#
+# trolld - a server, that keeps the debug information of ELF files resident,
+# and answers queries about it over a local socket
+#
+#-------------------------------------------------
+
+QT       += core network
+QT       -= gui
+CONFIG	+= console
+CONFIG	-= app_bundle
+
+TARGET = trolld
+TEMPLATE = app
+QMAKE_CXXFLAGS += -Wno-sign-compare
+
+# Do not pull the Qt widgets module in libtroll
+DEFINES += LIBTROLL_GUI_ENABLED=0
+
+SOURCES += \
+    main.cxx \
+    dwarf-query-server.cxx \
+    ../libtroll/libtroll.cxx
+
+HEADERS += \
+    dwarf-query-server.hxx \
+    ../libtroll/dwarf.h \
+    ../libtroll/libtroll.hxx \
+    ../elf-symbol-index.hxx \
+    ../elf-debug-data.hxx \
+    ../util.hxx
+
+INCLUDEPATH += .. ../libtroll/ ../external-sources/ELFIO/
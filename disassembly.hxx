@@ -25,14 +25,17 @@ THE SOFTWARE.
 #include <QFile>
 #include <QVector>
 #include <QPair>
-#include <QRegExp>
+#include <QMap>
 #include <QDebug>
 #include <QMessageBox>
 #include <stdint.h>
+#include <algorithm>
 #include "memory.hxx"
 #include "target.hxx"
 #include "util.hxx"
+#include "elf-symbol-index.hxx"
 
+#include <elfio/elfio.hpp>
 #include <platform.h>
 #include <capstone/capstone.h>
 
@@ -41,149 +44,303 @@ enum
 	DISASSEMBLY_AROUND_ADDRESS_CONTEXT_LINE_COUNT	= 100,
 };
 
+/* Disassembles the executable sections of the target ELF file. The executable sections are split in blocks at
+ * function symbols and at ARM ELF mapping symbols ('$t' - start of code, '$d' - start of data, such as literal pools),
+ * so that each block starts at a known instruction boundary, and contains either only code, or only data. Blocks
+ * are disassembled on demand, the first time some address in a block is requested, and the disassembly is cached */
 class Disassembly
 {
 private:
 	csh cs_handle;
+	/* preallocated instruction, used for all disassembly */
+	cs_insn * insn;
+	/* target memory contents, used for disassembling addresses outside of the ELF executable sections */
 	Memory	memory;
-	QByteArray	disassembly_text;
-	QVector<QPair<uint32_t /* address */, int /* index in disassembly text */> > index_table;
-	int indexOfAddress(uint32_t address)
+	/* contents of the ELF executable sections, at their virtual addresses */
+	Memory	code_memory;
+	/* used for annotating branch targets */
+	const ElfSymbolIndex & symbols;
+	struct code_block
 	{
-		int l = 0, h = index_table.size() - 1, m;
-		while (l <= h)
-		{
-			m = (l + h) >> 1;
-			if (index_table.at(m).first == address)
+		uint32_t	address;
+		uint32_t	end;
+		bool		is_data;
+		bool		is_disassembled;
+		QVector<QPair<uint32_t /* address */, QString /* disassembly */> > lines;
+	};
+	/* sorted by address, non-overlapping */
+	QVector<struct code_block> code_blocks;
+
+	/* Returns the index of the code block containing the address passed, or -1 if there is no such block */
+	int codeBlockIndex(uint32_t address) const
+	{
+		int i = std::upper_bound(code_blocks.cbegin(), code_blocks.cend(), address,
+			[] (uint32_t address, const struct code_block & block) -> bool
+				{ return address < block.address; }) - code_blocks.cbegin() - 1;
+		if (i < 0 || address >= code_blocks[i].end)
+			return -1;
+		return i;
+	}
+	QString instructionText(void)
+	{
+		QString text = QString("%1:\t%2\t%3\t\t%4")
+				.arg(insn->address, 8, 16, QChar('0'))
+				.arg(QString(QByteArray((const char *) insn->bytes, insn->size).toHex()))
+				.arg(insn->mnemonic).arg(insn->op_str);
+		/* annotate branch targets - the target of a direct branch or call (including 'cbz' and 'cbnz') is its
+		 * immediate operand; other instructions with an immediate operand (e.g., 'svc', 'bkpt') are not annotated */
+		if (!cs_insn_group(cs_handle, insn, CS_GRP_JUMP) && !cs_insn_group(cs_handle, insn, CS_GRP_CALL))
+			return text;
+		int i;
+		for (i = insn->detail->arm.op_count - 1; i >= 0; i --)
+			if (insn->detail->arm.operands[i].type == ARM_OP_IMM)
+			{
+				uint32_t target_address = insn->detail->arm.operands[i].imm;
+				auto s = symbols.symbolForAddress(target_address);
+				if (s && s->is_function)
+					text += QString("\t; <%1>").arg(symbols.describeAddress(target_address));
 				break;
-			if (index_table.at(m).first < address)
-				l = m + 1;
+			}
+		return text;
+	}
+	static QString dataText(uint32_t address, const QByteArray & data)
+	{
+		uint32_t x = 0;
+		int i;
+		for (i = data.size() - 1; i >= 0; x = (x << 8) | (uint8_t) data.at(i --));
+		return QString("%1:\t%2\t%3\t0x%4")
+				.arg(address, 8, 16, QChar('0'))
+				.arg(QString(data.toHex()))
+				.arg(data.size() == 4 ? ".word" : (data.size() == 2 ? ".short" : ".byte"))
+				.arg(x, data.size() * 2, 16, QChar('0'));
+	}
+	void disassembleBlock(struct code_block & block)
+	{
+		QByteArray data = code_memory.view(block.address, block.end - block.address);
+		const uint8_t * code = (const uint8_t *) data.constData();
+		size_t size = data.size();
+		uint64_t address = block.address;
+
+		block.is_disassembled = true;
+		while (size)
+		{
+			if (block.is_data)
+			{
+				/* emit words, aligned at word boundaries */
+				int length = (address & 3) ? Util::min<int>(4 - (address & 3), size) : Util::min<int>(4, size);
+				if (length == 3)
+					length = 1;
+				block.lines << QPair<uint32_t, QString>(address, dataText(address, QByteArray((const char *) code, length)));
+				address += length, code += length, size -= length;
+			}
+			else if (cs_disasm_iter(cs_handle, & code, & size, & address, insn))
+				block.lines << QPair<uint32_t, QString>(insn->address, instructionText());
 			else
-				h = m - 1;
+			{
+				int length = Util::min<int>(2, size);
+				block.lines << QPair<uint32_t, QString>(address, dataText(address, QByteArray((const char *) code, length)) + "\t<<< cannot disassemble >>>");
+				address += length, code += length, size -= length;
+			}
 		}
-		if (l > h)
-			return -1;
-		return m;
 	}
-	QString disassembleBytes(const QByteArray & data, uint32_t address)
+	/* Returns a known instruction boundary, which is the given number of instructions before the address passed, or less
+	 * if the start of the code is reached; returns false if the address passed is not in the ELF executable sections */
+	bool instructionBoundaryBefore(uint32_t address, int instruction_count, uint32_t & boundary)
 	{
-		QString dis;
-		int count;
-		if (data.size() != 2 && data.size() != 4)
-			Util::panic();
-		cs_insn		* insn;
+		int i = codeBlockIndex(address);
+		if (i == -1)
+			return false;
+		if (!code_blocks[i].is_disassembled)
+			disassembleBlock(code_blocks[i]);
+		int line = std::upper_bound(code_blocks[i].lines.cbegin(), code_blocks[i].lines.cend(), address,
+			[] (uint32_t address, const QPair<uint32_t, QString> & line) -> bool { return address < line.first; }) - code_blocks[i].lines.cbegin() - 1;
+		while ((line -= instruction_count) < 0 && i && code_blocks[i - 1].end == code_blocks[i].address)
+		{
+			/* continue in the preceding block */
+			instruction_count = - line;
+			if (!code_blocks[-- i].is_disassembled)
+				disassembleBlock(code_blocks[i]);
+			line = code_blocks[i].lines.size();
+		}
+		boundary = code_blocks[i].lines.at(Util::max(line, 0)).first;
+		return true;
+	}
+	/* Returns the address at which disassembly of the data passed, starting at the address passed, reaches or
+	 * passes the target address passed */
+	uint32_t disassemblyEndAddress(const QByteArray & data, uint32_t address, uint32_t target_address)
+	{
+		const uint8_t * code = (const uint8_t *) data.constData();
+		size_t size = data.size();
+		uint64_t a = address;
+		while (a < target_address && size)
+			if (!cs_disasm_iter(cs_handle, & code, & size, & a, insn))
+			{
+				int length = Util::min<int>(2, size);
+				a += length, code += length, size -= length;
+			}
+		return a;
+	}
+	/* Disassembles the data passed, which starts at the address passed; areas which are known to contain data,
+	 * and not code, are not disassembled */
+	QList<QPair<uint32_t, QString> > disassembleWindow(const QByteArray & data, uint32_t address)
+	{
+		QList<QPair<uint32_t, QString> > dis;
+		const uint8_t * code = (const uint8_t *) data.constData();
+		size_t size = data.size();
+		uint64_t a = address;
+		int i;
 
-		if ((count = cs_disasm(cs_handle, (const uint8_t *) data.constData(), data.length(), address, 0, & insn) == 1) && insn->size == data.size())
-			dis = QString("%1:\t%2\t%3\t\t%4")
-		                                  .arg(insn->address, 8, 16, QChar('0'))
-		                                  .arg(QString(QByteArray((const char *) insn->bytes, insn->size).toHex()))
-		                                  .arg(insn->mnemonic).arg(insn->op_str);
-		cs_free(insn, count);
+		while (size)
+		{
+			if ((i = codeBlockIndex(a)) != -1 && code_blocks[i].is_data)
+			{
+				int length = (a & 3) ? 4 - (a & 3) : 4;
+				length = Util::min<int>(Util::min<int>(length, code_blocks[i].end - a), size);
+				if (length == 3)
+					length = 1;
+				dis << QPair<uint32_t, QString>(a, dataText(a, QByteArray((const char *) code, length)));
+				a += length, code += length, size -= length;
+			}
+			else if (cs_disasm_iter(cs_handle, & code, & size, & a, insn))
+				dis << QPair<uint32_t, QString>(insn->address, instructionText());
+			else
+			{
+				int length = Util::min<int>(2, size);
+				dis << QPair<uint32_t, QString>(a, dataText(a, QByteArray((const char *) code, length)) + "\t<<< cannot disassemble >>>");
+				a += length, code += length, size -= length;
+			}
+		}
 		return dis;
 	}
+	void buildCodeBlocks(const ELFIO::elfio & elf)
+	{
+		int i;
+		unsigned j;
+		/* the values are true for data blocks, and false for code blocks */
+		QMap<uint32_t, bool> boundaries, mapping_symbols;
+
+		for (i = 0; i < elf.sections.size(); i ++)
+		{
+			const ELFIO::section * section = elf.sections[i];
+			if (section->get_type() != SHT_SYMTAB)
+				continue;
+			ELFIO::symbol_section_accessor symbols(elf, const_cast<ELFIO::section *>(section));
+			for (j = 0; j < symbols.get_symbols_num(); j ++)
+			{
+				std::string name;
+				ELFIO::Elf64_Addr value;
+				ELFIO::Elf_Xword size;
+				unsigned char bind, type, other;
+				ELFIO::Elf_Half section_index;
+				if (!symbols.get_symbol(j, name, value, size, bind, type, section_index, other) || section_index == SHN_UNDEF)
+					continue;
+				if (name == "$t" || name.compare(0, 3, "$t.") == 0 || name == "$a" || name.compare(0, 3, "$a.") == 0)
+					mapping_symbols[value] = false;
+				else if (name == "$d" || name.compare(0, 3, "$d.") == 0)
+					mapping_symbols[value] = true;
+				else if (type == STT_FUNC)
+					/* clear the thumb bit */
+					boundaries[value & ~1] = false;
+			}
+		}
+		/* mapping symbols take precedence over function symbols */
+		for (auto m = mapping_symbols.cbegin(); m != mapping_symbols.cend(); m ++)
+			boundaries[m.key()] = m.value();
+
+		QMap<uint32_t, const ELFIO::section *> code_sections;
+		for (i = 0; i < elf.sections.size(); i ++)
+		{
+			const ELFIO::section * section = elf.sections[i];
+			if (section->get_type() == SHT_PROGBITS && section->get_size()
+					&& (section->get_flags() & (SHF_ALLOC | SHF_EXECINSTR)) == (SHF_ALLOC | SHF_EXECINSTR))
+				code_sections[section->get_address()] = section;
+		}
+		for (auto section : code_sections)
+		{
+			uint32_t address = section->get_address(), end = address + section->get_size();
+			if (!code_blocks.isEmpty() && code_blocks.last().end > address)
+				/* overlapping sections - should not happen */
+				continue;
+			code_memory.addRange(address, QByteArray(section->get_data(), section->get_size()));
+			/* unless marked otherwise, assume that a section starts with code */
+			bool is_data = false;
+			QMap<uint32_t, bool>::const_iterator b = boundaries.lowerBound(address);
+			while (address < end)
+			{
+				if (b != boundaries.cend() && b.key() == address)
+					is_data = b.value(), b ++;
+				uint32_t block_end = (b != boundaries.cend() && b.key() < end) ? b.key() : end;
+				code_blocks.push_back((struct code_block) { .address = address, .end = block_end, .is_data = is_data, .is_disassembled = false, .lines = {}, });
+				address = block_end;
+			}
+		}
+	}
 public:
-	Disassembly(QByteArray disassembly, const Memory & memory)
+	Disassembly(const ELFIO::elfio & elf, const Memory & memory, const ElfSymbolIndex & symbols) : symbols(symbols)
 	{
-		int i = 0, x;
-		bool ok;
-		QRegExp rx("^\\s*(\\w+):"
-		/* Note: a whitespace is expected here, because the objdump disassembly
-		 * normally starts with something like:
-		 * "<Filename>:	file format elf32-littlearm"
-		 * and the file name may contain the complete path to the file.
-		 * Now, on a windows machine, if the file is in a windows drive which is a
-		 * valid hex digit (i.e., in the range 'a' - 'f'), then this line is being
-		 * incorrectly detected as a valid disassembly line (e.g., if the file is in the 'c'
-		 * drive, a disassmbly line is being detected for address 0x0000000c).
-		 * To avoid such incorrect detection of disassembly lines in the objdump
-		 * disassembly output, only accept lines which contain some whitespace after
-		 * the colon character.
-		 */
-		"\\s+");
 		this->memory = memory;
-		if (cs_open(CS_ARCH_ARM, CS_MODE_THUMB, & cs_handle))
+		/* instruction details are needed for annotating branch targets; they must be enabled before allocating the instruction */
+		if (cs_open(CS_ARCH_ARM, CS_MODE_THUMB, & cs_handle) || cs_option(cs_handle, CS_OPT_DETAIL, CS_OPT_ON) || !(insn = cs_malloc(cs_handle)))
 		{
 			QMessageBox::critical(0, "failed to initialize the disassembly library",
 					      "failed to initialize the disassembly library\n\n"
 					      "this is a fatal error, and the troll will now abort");
 			Util::panic();
 		}
-		//return;
-
-		disassembly_text = disassembly;
-		while (i < disassembly_text.size())
-		{
-			QString s(disassembly_text.mid(i, (x = disassembly_text.indexOf('\n', i)) - i));
-			if (rx.indexIn(s) != -1)
-			{
-				uint32_t address = rx.cap(1).toUInt(& ok, 16);
-				if (ok)
-					index_table << QPair<uint32_t, int>(address, i);
-			}
-			if (x == -1)
-				break;
-			i = x + 1;
-		}
-		for (i = 1; i < index_table.size(); i ++)
-			if (index_table.at(i).first <= index_table.at(i - 1).first)
-				Util::panic();
+		buildCodeBlocks(elf);
+	}
+	~Disassembly()
+	{
+		cs_free(insn, 1);
+		cs_close(& cs_handle);
 	}
-	/*! \todo	reading target memory here with	'readBytes()' is ***slow*** - maybe fix this */
+	/* Returns the disassembly around the address passed. Target memory is read only once, for the whole
+	 * disassembly window. The window start is anchored at a known instruction boundary, found from the
+	 * ELF symbols, so that disassembly before the address passed is correct. For addresses outside of
+	 * the ELF executable sections, the window start is chosen so that disassembly from the window start
+	 * synchronizes with the address passed */
 	QList<QPair<uint32_t, QString> > disassemblyAroundAddress(uint32_t address, class Target * target, int * line_for_address = 0)
 	{
-		QString x;
 		QList<QPair<uint32_t, QString> > dis;
-		QPair<uint32_t, QString> t;
-		uint32_t l, h, i = 0;
-		QByteArray data;
+		uint32_t start, end = address + (DISASSEMBLY_AROUND_ADDRESS_CONTEXT_LINE_COUNT + 1) * 4;
+		bool is_anchored;
+		int i;
+
 		if (line_for_address)
 			* line_for_address = -1;
-		data = target->readBytes(address, 4, true);
-		if (!data.size())
+		if (end < address)
+			end = -1;
+		if (!(is_anchored = instructionBoundaryBefore(address, DISASSEMBLY_AROUND_ADDRESS_CONTEXT_LINE_COUNT, start)))
+			/* assume an average instruction size of 2 bytes */
+			start = (address < DISASSEMBLY_AROUND_ADDRESS_CONTEXT_LINE_COUNT * 2) ? 0 : address - DISASSEMBLY_AROUND_ADDRESS_CONTEXT_LINE_COUNT * 2;
+
+		QByteArray data = target->readBytes(start, end - start, true);
+		if (data.size() <= (int) (address - start) && start != address)
+			/* maybe memory before the address is not readable - retry reading from the address */
+			data = target->readBytes(start = address, end - address, true), is_anchored = true;
+		if (data.isEmpty())
 		{
 			dis.push_back(QPair<uint32_t, QString> (address, QString("<<< cannot read memory at address $%1 >>>").arg(address, 8, 16, QChar('0'))));
 			return dis;
 		}
-		if (!(x = disassembleBytes(data.left(2), address)).isEmpty())
-			h = address + 2, dis.push_back(QPair<uint32_t, QString> (address, x));
-		else if (!(x = disassembleBytes(data, address)).isEmpty())
-			h = address + 4, dis.push_back(QPair<uint32_t, QString> (address, x));
-		else
+		if (!is_anchored)
 		{
-			dis.push_back(QPair<uint32_t, QString> (address, QString("<<< cannot disassemble bytes at address $%1 >>>").arg(address, 8, 16, QChar('0'))));
-			return dis;
+			/* find a start address from which disassembly synchronizes with the address requested */
+			uint32_t offset;
+			for (offset = 0; start + offset < address; offset += 2)
+				if (disassemblyEndAddress(data.mid(offset), start + offset, address) == address)
+					break;
+			data.remove(0, offset);
+			start += offset;
 		}
-		l = address;
-		for (i = 0; i < DISASSEMBLY_AROUND_ADDRESS_CONTEXT_LINE_COUNT; i ++)
-		{
-			l -= 4;
-			data = target->readBytes(l, 4, true);
-			if (!data.size())
-			{
-				dis.push_front(QPair<uint32_t, QString> (l, QString("<<< cannot read memory at address $%1 >>>").arg(l, 8, 16, QChar('0'))));
-				return dis;
-			}
-			if (!(x = disassembleBytes(data.right(2), l + 2)).isEmpty())
-				l += 2, t.first = l, t.second = x, dis.push_front(t);
-			else if (!(x = disassembleBytes(data, l)).isEmpty())
-				t.first = l, t.second = x, dis.push_front(t);
-			else
-				l += 2,t.first = l + 2, t.second = QString("<<< cannot disassemble bytes at address $%1 >>>").arg(l, 8, 16, QChar('0')),  dis.push_front(t);
 
-			t.first = h;
-			data = target->readBytes(h, 4, true);
-			if (!data.size())
-			{
-				dis.push_back(QPair<uint32_t, QString> (h, QString("<<< cannot read memory at address $%1 >>>").arg(h, 8, 16, QChar('0'))));
-				return dis;
-			}
-			if (!(x = disassembleBytes(data, h)).isEmpty())
-				h += 4, t.second = x, dis.push_back(t);
-			else if (!(x = disassembleBytes(data.left(2), h)).isEmpty())
-				h += 2, t.second = x, dis.push_back(t);
-			else
-				h += 2, t.second = QString("<<< cannot disassemble bytes at address $%1 >>>").arg(h, 8, 16, QChar('0')), dis.push_back(t);
-		}
+		dis = disassembleWindow(data, start);
+		for (i = 0; i < dis.size() && dis.at(i).first <= address; i ++);
+		i = Util::max(i - 1, 0);
+		if (dis.size() > i + DISASSEMBLY_AROUND_ADDRESS_CONTEXT_LINE_COUNT + 1)
+			dis.erase(dis.begin() + i + DISASSEMBLY_AROUND_ADDRESS_CONTEXT_LINE_COUNT + 1, dis.end());
+		if (i > DISASSEMBLY_AROUND_ADDRESS_CONTEXT_LINE_COUNT)
+			dis.erase(dis.begin(), dis.begin() + i - DISASSEMBLY_AROUND_ADDRESS_CONTEXT_LINE_COUNT), i = DISASSEMBLY_AROUND_ADDRESS_CONTEXT_LINE_COUNT;
 		if (line_for_address)
 			* line_for_address = i;
 		return dis;
@@ -194,70 +351,31 @@ public:
 		int i;
 		while (start < end)
 		{
-			i = indexOfAddress(start);
-
-			if (i == -1 || i == /* not really exact, but doesn't matter anyway */ index_table.size() - 1)
+			if ((i = codeBlockIndex(start)) == -1)
 			{
-				cs_insn		* insn;
-				auto x = memory.data(start, 4);
-				i = cs_disasm(cs_handle, (const uint8_t *) x.constData(), x.length(), start, 0, & insn);
+				/* address not in the ELF executable sections - try disassembling the target memory contents */
+				QByteArray x = memory.view(start, 4);
+				const uint8_t * code = (const uint8_t *) x.constData();
+				size_t size = x.size();
+				uint64_t address = start;
 
-				if (!i)
+				if (!cs_disasm_iter(cs_handle, & code, & size, & address, insn))
 					return dis << QPair<uint32_t, QString>(start, QString("<<< no disassembly for address $%1 >>>").arg(start, 8, 16, QChar('0')));
-				dis << QPair<uint32_t , QString >(insn->address, QString("%1:\t%2\t%3\t\t%4")
-								  .arg(insn->address, 8, 16, QChar('0'))
-								  .arg(QString(QByteArray((const char *) insn->bytes, insn->size).toHex()))
-								  .arg(insn->mnemonic).arg(insn->op_str));
-				start += insn->size;
-				cs_free(insn, i);
-			}
-			else
-			{
-				dis << QPair<uint32_t , QString >(start, disassembly_text.mid(index_table.at(i).second, disassembly_text.indexOf('\n', index_table.at(i).second) - index_table.at(i).second ));
-				start = index_table.at(++ i).first;
+				dis << QPair<uint32_t , QString >(insn->address, instructionText());
+				start = address;
+				continue;
 			}
+			struct code_block & block = code_blocks[i];
+			if (!block.is_disassembled)
+				disassembleBlock(block);
+			auto line = std::lower_bound(block.lines.cbegin(), block.lines.cend(), start,
+				[] (const QPair<uint32_t, QString> & line, uint32_t address) -> bool { return line.first < address; });
+			for (; line != block.lines.cend() && line->first < end; line ++)
+				dis << * line;
+			start = block.end;
 		}
 		return dis;
 	}
-	void disassemble(const uint8_t * bytes, int length, uint32_t address)
-	{
-		csh handle;
-		cs_insn * insn;
-		int i;
-		size_t count;
-		cs_err err;
-
-			err = cs_open(CS_ARCH_ARM, CS_MODE_THUMB, &handle);
-			if (err)
-			{
-				printf("Failed on cs_open() with error returned: %u\n", err);
-				return;
-			}
-
-			count = cs_disasm(handle, bytes, length, address, 0, & insn);
-			if (count)
-			{
-				size_t j;
-
-				//print_string_hex(platforms[i].code, platforms[i].size);
-				printf("Disasm:\n");
-
-				for (j = 0; j < count; j++) {
-					fprintf(stderr, "%08x"  ":\t%s\t\t%s\n",
-					       (uint32_t) insn[j].address, insn[j].mnemonic, insn[j].op_str);
-				}
-
-				// print out the next offset, after the last insn
-				printf("0x%08x"  ":\n", (uint32_t) insn[j-1].address + insn[j-1].size);
-
-				// free memory allocated by cs_disasm()
-				cs_free(insn, count);
-			}
-
-			printf("\n");
-
-			cs_close(&handle);
-	}
 };
 
 #endif // DISASSEMBLY_HXX
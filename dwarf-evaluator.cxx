@@ -22,6 +22,7 @@ THE SOFTWARE.
 #include <QMessageBox>
 #include <QFile>
 #include "dwarf-evaluator.hxx"
+#include "memory.hxx"
 
 #include "dwarf-type-stack.hxx"
 
@@ -395,13 +396,16 @@ DwarfEvaluator::DwarfExpressionValue DwarfEvaluator::evaluateLocation(uint32_t c
 	return result;
 }
 
-QByteArray DwarfEvaluator::fetchValueFromTarget(const DwarfEvaluator::DwarfExpressionValue& location, Target * target, int bytesize)
+QByteArray DwarfEvaluator::fetchValueFromTarget(const DwarfEvaluator::DwarfExpressionValue& location, Target * target, int bytesize, const Memory * prefetched_memory)
 {
 QByteArray data;
 	switch (location.type)
 	{
 		case DwarfEvaluator::DwarfExpressionValue::MEMORY_ADDRESS:
-			data = target->readBytes(location.value, bytesize, true);
+			if (prefetched_memory)
+				data = prefetched_memory->data(location.value, bytesize);
+			if (data.size() != bytesize)
+				data = target->readBytes(location.value, bytesize, true);
 			break;
 		case DwarfEvaluator::DwarfExpressionValue::REGISTER_NUMBER:
 		{
@@ -413,7 +417,7 @@ QByteArray data;
 			break;
 		case DwarfEvaluator::DwarfExpressionValue::COMPOSITE_VALUE:
 			for (const auto& piece : location.pieces)
-				data += fetchValueFromTarget(piece.details, target, piece.byte_size);
+				data += fetchValueFromTarget(piece.details, target, piece.byte_size, prefetched_memory);
 			return data;
 		case DwarfEvaluator::DwarfExpressionValue::CONSTANT:
 			data = QByteArray((const char *) & location.value, sizeof location.value);
@@ -435,3 +439,20 @@ QByteArray data;
 	}
 	return data.toHex();
 }
+
+void DwarfEvaluator::memoryRangesForLocation(const DwarfEvaluator::DwarfExpressionValue& location, int bytesize, QVector<QPair<uint32_t, int> > & ranges)
+{
+	switch (location.type)
+	{
+		case DwarfEvaluator::DwarfExpressionValue::MEMORY_ADDRESS:
+			if (bytesize > 0)
+				ranges.push_back(QPair<uint32_t, int>(location.value, bytesize));
+			break;
+		case DwarfEvaluator::DwarfExpressionValue::COMPOSITE_VALUE:
+			for (const auto& piece : location.pieces)
+				memoryRangesForLocation(piece.details, piece.byte_size, ranges);
+			break;
+		default:
+			break;
+	}
+}
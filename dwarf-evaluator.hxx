@@ -78,8 +78,14 @@ public:
 	/* The format of the returned data is this - for each successfully retrieved byte of data, two ascii
 	 * bytes are present, which contain the hexadecimal representation of that byte. For each
 	 * byte that is unavailable (e.g., it has been optimized away, or can not be retrieved from the target),
-	 * the bytes "??" are * stored */
-	static QByteArray fetchValueFromTarget(const struct DwarfExpressionValue& location, Target * target, int bytesize);
+	 * the bytes "??" are * stored
+	 * If 'prefetched_memory' is supplied, memory contents are taken from it whenever possible,
+	 * and the target is only accessed for memory not available in 'prefetched_memory' */
+	static QByteArray fetchValueFromTarget(const struct DwarfExpressionValue& location, Target * target, int bytesize, const class Memory * prefetched_memory = 0);
+	/* Appends to 'ranges' the target memory ranges that need to be read in order to fetch the value
+	 * of the data object at 'location'; used for gathering all memory ranges that need to be read
+	 * from the target, so that they can be read in a single batch with 'Target::readRanges()' */
+	static void memoryRangesForLocation(const struct DwarfExpressionValue& location, int bytesize, QVector<QPair<uint32_t, int> > & ranges);
 signals:
 	void entryValueComputed(struct DwarfEvaluator::DwarfExpressionValue entry_value);
 };
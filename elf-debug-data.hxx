@@ -0,0 +1,137 @@
+/*
+Copyright (c) 2019 stoyan shopov
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+#ifndef ELFDEBUGDATA_HXX
+#define ELFDEBUGDATA_HXX
+
+#include <QString>
+#include <QByteArray>
+#include <QVector>
+#include <stdint.h>
+#include <vector>
+
+#include <elfio/elfio.hpp>
+
+#include "libtroll.hxx"
+#include "elf-symbol-index.hxx"
+
+/* The debug information of an ELF file, loaded for the front ends that run without the troll's main window (the
+ * batch crash triage, the 'troll-addr2line' symbolizer, and the 'trolld' server). The contents of the debug sections
+ * are kept here, because the DWARF parser refers to them, instead of making its own copies */
+class ElfDebugData
+{
+public:
+	ELFIO::elfio	elf;
+	QByteArray	debug_info, debug_types, debug_abbrev, debug_frame, debug_ranges, debug_str, debug_line, debug_loc;
+	DwarfData	* dwdata = 0;
+	/* null if the ELF file contains no '.debug_frame' section */
+	DwarfUnwinder	* dwundwind = 0;
+	ElfSymbolIndex	elf_symbols;
+
+	~ElfDebugData() { delete dwundwind; delete dwdata; }
+	/* Loads an ELF file, and indexes its debug information and symbols; returns false on error */
+	bool load(const QString & elf_filename, QString & error_message)
+	{
+		int i;
+		if (!elf.load(elf_filename.toStdString()))
+			return error_message = "cannot read ELF file " + elf_filename, false;
+		if (elf.get_class() != ELFCLASS32 || elf.get_encoding() != ELFDATA2LSB)
+			return error_message = "only 32 bit, little-endian encoded ELF files are supported", false;
+		for (i = 1; i < elf.sections.size(); i ++)
+		{
+			auto name = elf.sections[i]->get_name();
+			QByteArray data(elf.sections[i]->get_data(), elf.sections[i]->get_size());
+			if (name == ".debug_info") debug_info = data;
+			else if (name == ".debug_types") debug_types = data;
+			else if (name == ".debug_abbrev") debug_abbrev = data;
+			else if (name == ".debug_frame") debug_frame = data;
+			else if (name == ".debug_ranges") debug_ranges = data;
+			else if (name == ".debug_str") debug_str = data;
+			else if (name == ".debug_line") debug_line = data;
+			else if (name == ".debug_loc") debug_loc = data;
+		}
+		if (debug_info.isEmpty())
+			return error_message = "no debug information found in ELF file " + elf_filename, false;
+		dwdata = new DwarfData(debug_info.data(), debug_info.length(), debug_types.data(), debug_types.length(), debug_abbrev.data(), debug_abbrev.length(),
+				       debug_ranges.data(), debug_ranges.length(), debug_str.data(), debug_str.length(), debug_line.data(), debug_line.length(),
+				       debug_loc.data(), debug_loc.length());
+		if (!debug_frame.isEmpty())
+			dwundwind = new DwarfUnwinder(debug_frame.data(), debug_frame.length());
+		elf_symbols.build(elf);
+		return true;
+	}
+
+	/* Returns the path of a source file, as it should be reported to the user */
+	static QString sourceFilePath(const char * file_name, const char * directory_name)
+	{
+		if (* file_name == '/' || * file_name == '\\' || (* file_name && file_name[1] == ':') || * directory_name == '<')
+			return file_name;
+		return QString(directory_name) + '/' + file_name;
+	}
+
+	/* a function, and a location in the source code of the function; the line number is -1 if unknown */
+	struct SourceLocation
+	{
+		QString		function;
+		QString		file;
+		int		line;
+	};
+	/* Symbolizes an address, given its execution context and source code coordinates (as returned by the DWARF data
+	 * queries, e.g. the batch address queries). Returns the innermost function first - the one containing the address,
+	 * followed by the functions it is inlined in, each with the location of the call site of the previous function.
+	 * When there is no debug information for the address, the function name is taken from the ELF symbol table */
+	QVector<struct SourceLocation> symbolize(uint32_t address, const std::vector<struct Die> & context, const struct SourceCodeCoordinates & coordinates)
+	{
+		QVector<struct SourceLocation> locations;
+		QString function;
+		int i;
+
+		for (const auto & die : context)
+			if (die.isNonInlinedSubprogram())
+			{
+				function = dwdata->nameOfDie(die);
+				break;
+			}
+		if (function.isEmpty())
+			function = elf_symbols.describeAddress(address);
+		if (context.empty())
+		{
+			locations.push_back((struct SourceLocation) { .function = function, .file = QString(), .line = -1, });
+			return locations;
+		}
+
+		auto inlining_chain = dwdata->inliningChainOfContext(context);
+		locations.push_back((struct SourceLocation) { .function = inlining_chain.empty() ? function : QString(dwdata->nameOfDie(inlining_chain.at(0))),
+				.file = coordinates.line == -1 ? QString() : sourceFilePath(coordinates.file_name, coordinates.directory_name),
+				.line = (int) coordinates.line, });
+		/* the call site of each inlined function is in the next function up the inlining chain */
+		for (i = 0; i < inlining_chain.size(); i ++)
+		{
+			auto c = dwdata->sourceCodeCoordinatesForDieOffset(inlining_chain.at(i).offset);
+			locations.push_back((struct SourceLocation) { .function = i + 1 < inlining_chain.size() ? QString(dwdata->nameOfDie(inlining_chain.at(i + 1))) : function,
+					.file = c.call_line == -1 ? QString() : sourceFilePath(c.call_file_name, c.call_directory_name),
+					.line = (int) c.call_line, });
+		}
+		return locations;
+	}
+};
+
+#endif // ELFDEBUGDATA_HXX
@@ -0,0 +1,127 @@
+/*
+Copyright (c) 2019 stoyan shopov
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+#ifndef ELFSYMBOLINDEX_HXX
+#define ELFSYMBOLINDEX_HXX
+
+#include <QVector>
+#include <QHash>
+#include <QString>
+#include <stdint.h>
+#include <algorithm>
+#include "util.hxx"
+
+#include <elfio/elfio.hpp>
+
+/* An index of the function and data object symbols in the ELF symbol table ('.symtab'), for finding the symbol
+ * containing an address, and for finding the address of a symbol by name. This is useful for code and data that
+ * has no debug information, such as startup code written in assembly, and libraries supplied without sources */
+class ElfSymbolIndex
+{
+public:
+	struct Symbol
+	{
+		uint32_t	address;
+		uint32_t	size;
+		QString		name;
+		bool		is_function;
+		bool		is_global;
+	};
+private:
+	/* sorted by address */
+	QVector<struct Symbol> symbols;
+	QHash<QString, int /* index in 'symbols' */> symbol_indices;
+public:
+	void build(const ELFIO::elfio & elf)
+	{
+		int i;
+		unsigned j;
+
+		symbols.clear();
+		symbol_indices.clear();
+		for (i = 0; i < elf.sections.size(); i ++)
+		{
+			const ELFIO::section * section = elf.sections[i];
+			if (section->get_type() != SHT_SYMTAB)
+				continue;
+			ELFIO::symbol_section_accessor elf_symbols(elf, const_cast<ELFIO::section *>(section));
+			for (j = 0; j < elf_symbols.get_symbols_num(); j ++)
+			{
+				std::string name;
+				ELFIO::Elf64_Addr value;
+				ELFIO::Elf_Xword size;
+				unsigned char bind, type, other;
+				ELFIO::Elf_Half section_index;
+				if (!elf_symbols.get_symbol(j, name, value, size, bind, type, section_index, other)
+						|| section_index == SHN_UNDEF || name.empty() || name[0] == '$'
+						|| (type != STT_FUNC && type != STT_OBJECT))
+					continue;
+				symbols.push_back((struct Symbol) { .address = (uint32_t) (type == STT_FUNC ? value & ~1 : value),
+						.size = (uint32_t) size, .name = QString::fromStdString(name), .is_function = type == STT_FUNC, .is_global = bind != STB_LOCAL, });
+			}
+		}
+		/* for symbols at the same address, put sized symbols last, so that they are preferred by lookups */
+		std::stable_sort(symbols.begin(), symbols.end(), [] (const struct Symbol & a, const struct Symbol & b) -> bool
+			{ return a.address < b.address || (a.address == b.address && a.size < b.size); });
+		for (i = 0; i < symbols.size(); i ++)
+		{
+			/* prefer global symbols over local ones with the same name */
+			auto x = symbol_indices.find(symbols.at(i).name);
+			if (x == symbol_indices.end())
+				symbol_indices.insert(symbols.at(i).name, i);
+			else if (symbols.at(i).is_global && !symbols.at(x.value()).is_global)
+				x.value() = i;
+		}
+	}
+	/* Returns the symbol containing the address passed, or null if there is no such symbol. Symbols without
+	 * a size (e.g., labels in assembly code) are considered to contain only their own address */
+	const struct Symbol * symbolForAddress(uint32_t address) const
+	{
+		int i = std::upper_bound(symbols.cbegin(), symbols.cend(), address,
+			[] (uint32_t address, const struct Symbol & symbol) -> bool { return address < symbol.address; }) - symbols.cbegin();
+		/* look back a few symbols, in case of nested or overlapping symbols */
+		int limit = Util::max(i - 4, 0);
+		while (i -- > limit)
+		{
+			const struct Symbol & s = symbols.at(i);
+			if (address == s.address || address - s.address < s.size)
+				return & s;
+		}
+		return 0;
+	}
+	/* Returns a 'symbol+offset' string for the address passed, or an empty string if no symbol contains the address */
+	QString describeAddress(uint32_t address) const
+	{
+		auto s = symbolForAddress(address);
+		if (!s)
+			return QString();
+		return address == s->address ? s->name : QString("%1+0x%2").arg(s->name).arg(address - s->address, 0, 16);
+	}
+	const struct Symbol * symbolForName(const QString & name) const
+	{
+		auto i = symbol_indices.constFind(name);
+		return i == symbol_indices.cend() ? 0 : & symbols.at(i.value());
+	}
+	int symbolCount(void) const { return symbols.size(); }
+	const struct Symbol & symbolAt(int index) const { return symbols.at(index); }
+};
+
+#endif // ELFSYMBOLINDEX_HXX
@@ -20,3 +20,58 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
 THE SOFTWARE.
 */
 #include "gdb-remote.hxx"
+#include <QElapsedTimer>
+
+void GdbRemotePacketFramer::benchmark(void)
+{
+	enum
+	{
+		PACKET_COUNT		= 1000,
+		/* simulate data arriving in full speed usb bulk transfer sized pieces */
+		RECEIVE_CHUNK_SIZE	= 64,
+	};
+	const int payload_sizes[] = { 1024, 4096, 16384, };
+	int i, j;
+
+	for (auto size : payload_sizes)
+	{
+		QByteArray payload(size, 0), stream, rle_stream, expanded;
+		/* binary payload, containing bytes that need escaping, including '*' characters */
+		for (i = 0; i < size; i ++)
+			payload[i] = (char) (i * 7);
+		/* simulate replies from a remote stub - these also escape the '*' characters in the payload */
+		for (i = 0; i < PACKET_COUNT; i ++)
+			stream += GdbRemote::makeReplyPacket(payload) + "+";
+		/* run-length encoded payload - each '0*~' sequence decodes to 98 '0' characters */
+		QByteArray rle_payload;
+		for (i = 0; i < size / 98; i ++)
+			rle_payload += "0*~", expanded += QByteArray(98, '0');
+		rle_payload = QByteArray("$") + rle_payload + "#" + QByteArray::number(GdbRemote::checksum(rle_payload) | 0x100, 16).right(2);
+		for (i = 0; i < PACKET_COUNT; i ++)
+			rle_stream += rle_payload;
+
+		struct { const char * name; const QByteArray & stream; const QByteArray & payload; } tests[] =
+		{
+			{ "binary, escaped", stream, payload, },
+			{ "run-length encoded", rle_stream, expanded, },
+		};
+		for (const auto & test : tests)
+		{
+			GdbRemotePacketFramer framer;
+			QByteArray x;
+			QElapsedTimer t;
+			int packet_count = 0, errors = 0;
+			t.start();
+			for (j = 0; j < test.stream.length(); j += RECEIVE_CHUNK_SIZE)
+			{
+				framer.feed(test.stream.constData() + j, Util::min((int) RECEIVE_CHUNK_SIZE, test.stream.length() - j));
+				while (framer.nextPacket(x))
+					packet_count ++, errors += (x != test.payload);
+			}
+			auto ns = t.nsecsElapsed();
+			qDebug() << "gdb remote framer benchmark:" << test.name << "payload size" << test.payload.size() << "bytes,"
+				 << packet_count << "packets," << errors << "errors," << framer.takeInvalidPacketCount() << "invalid packets,"
+				 << (ns ? test.stream.length() * 1000. / ns : 0.) << "MB/s";
+		}
+	}
+}
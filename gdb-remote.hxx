@@ -25,47 +25,218 @@ THE SOFTWARE.
 #include <QByteArray>
 #include <QString>
 #include <QVector>
-#include <QRegularExpression>
+#include <QHash>
 #include <QDebug>
+#include <deque>
 #include "util.hxx"
 
-class GdbRemote
+/* Incremental gdb remote serial protocol framer. Data received from the remote side is fed to the framer
+ * in arbitrarily sized pieces, as it arrives; packet framing, escaped bytes, run-length encoding
+ * and checksum validation are all handled in a single pass over the received data, without
+ * ever buffering or rescanning raw packet data. The payloads of valid packets received are
+ * queued, and can be retrieved with 'nextPacket()'; acknowledgments are queued separately,
+ * and can be retrieved with 'nextAcknowledgment()' */
+class GdbRemotePacketFramer
 {
 private:
-	static QByteArray escape(QByteArray data) { return data.replace('}', "}]").replace('#', "}\003").replace('$', "}\004"); }
-	static QByteArray unescape(QByteArray data) { int i; for (i = 0; i < data.length(); i ++) if (data[i] == '}') data.remove(i, 1), data[i] = data[i] ^ ' '; return data; }
-	static int checksum(const QByteArray & data) { int i, x; for (i = x = 0; i < data.length(); x += data[i ++]); return x & 0xff; }
-	static QByteArray strip(const QByteArray & packet) { return packet.mid(1, packet.length() - 4); }
-	static QByteArray makePacket(const QByteArray & data) { return QByteArray("$") + escape(data) + "#" + QString("%1").arg(checksum(escape(data)), 2, 16, QChar('0')).toLocal8Bit(); }
+	enum FRAMER_STATE
+	{
+		WAITING_FOR_PACKET_START	= 0,
+		RECEIVING_PAYLOAD,
+		RECEIVING_ESCAPED_BYTE,
+		RECEIVING_REPEAT_COUNT,
+		RECEIVING_CHECKSUM_HIGH_DIGIT,
+		RECEIVING_CHECKSUM_LOW_DIGIT,
+	}
+	state = WAITING_FOR_PACKET_START;
+	QByteArray payload;
+	std::deque<QByteArray> packets;
+	std::deque<char> acknowledgments;
+	unsigned char running_checksum = 0, received_checksum = 0;
+	bool is_packet_malformed = false, is_ignoring_acknowledgments = false;
+	int invalid_packet_count = 0;
+	static int hexDigitValue(unsigned char c)
+	{
+		if ('0' <= c && c <= '9') return c - '0';
+		if ('a' <= c && c <= 'f') return c - 'a' + 10;
+		if ('A' <= c && c <= 'F') return c - 'A' + 10;
+		return -1;
+	}
+	void startPacket(void) { payload.clear(); running_checksum = 0; is_packet_malformed = false; state = RECEIVING_PAYLOAD; }
 public:
-	static QByteArray extractPacket(QByteArray & bytes)
+	void reset(void)
 	{
-		QRegularExpression rx("\\$.*#..", QRegularExpression::InvertedGreedinessOption);
-		QRegularExpressionMatch match;
-		if ((match = rx.match(bytes)).hasMatch())
+		state = WAITING_FOR_PACKET_START;
+		payload.clear();
+		packets.clear();
+		acknowledgments.clear();
+		invalid_packet_count = 0;
+	}
+	/* in no-acknowledgment mode, any acknowledgments received are discarded */
+	void setIgnoringAcknowledgments(bool is_ignoring) { if ((is_ignoring_acknowledgments = is_ignoring)) acknowledgments.clear(); }
+	void feed(const QByteArray & data) { feed(data.constData(), data.length()); }
+	void feed(const char * data, int length)
+	{
+		const char * end = data + length;
+		while (data < end)
 		{
-			bytes.remove(0, match.capturedEnd());
-			return match.captured().toLocal8Bit();
+			unsigned char c = * data ++;
+			int x;
+			switch (state)
+			{
+				case WAITING_FOR_PACKET_START:
+					if (c == '$')
+						startPacket();
+					else if (c == '+' || c == '-')
+					{
+						if (!is_ignoring_acknowledgments)
+							acknowledgments.push_back(c);
+					}
+					break;
+				case RECEIVING_PAYLOAD:
+				{
+					/* Fast path - copy all ordinary payload bytes in one go */
+					const char * p = data - 1;
+					while (p < end && * p != '#' && * p != '}' && * p != '*' && * p != '$')
+						running_checksum += * p ++;
+					payload.append(data - 1, p - (data - 1));
+					if (p == end)
+					{
+						data = end;
+						break;
+					}
+					data = p + 1;
+					switch (c = * p)
+					{
+						case '#': state = RECEIVING_CHECKSUM_HIGH_DIGIT; break;
+						case '}': running_checksum += c; state = RECEIVING_ESCAPED_BYTE; break;
+						case '*': running_checksum += c; state = RECEIVING_REPEAT_COUNT; break;
+						/* Packet start character inside a packet - discard the data received so far, and resynchronize */
+						case '$': invalid_packet_count ++; startPacket(); break;
+					}
+				}
+					break;
+				case RECEIVING_ESCAPED_BYTE:
+					running_checksum += c;
+					payload.append((char) (c ^ 0x20));
+					state = RECEIVING_PAYLOAD;
+					break;
+				case RECEIVING_REPEAT_COUNT:
+					/* Run-length encoding - the last payload byte is repeated 'c - 29' more times */
+					running_checksum += c;
+					if (payload.isEmpty() || c < 29)
+						is_packet_malformed = true;
+					else
+						payload.append(c - 29, payload.at(payload.length() - 1));
+					state = RECEIVING_PAYLOAD;
+					break;
+				case RECEIVING_CHECKSUM_HIGH_DIGIT:
+					if ((x = hexDigitValue(c)) == -1)
+						is_packet_malformed = true;
+					received_checksum = x << 4;
+					state = RECEIVING_CHECKSUM_LOW_DIGIT;
+					break;
+				case RECEIVING_CHECKSUM_LOW_DIGIT:
+					if ((x = hexDigitValue(c)) == -1)
+						is_packet_malformed = true;
+					received_checksum |= x;
+					if (is_packet_malformed || received_checksum != running_checksum)
+						invalid_packet_count ++;
+					else
+						packets.push_back(payload);
+					payload.clear();
+					state = WAITING_FOR_PACKET_START;
+					break;
+			}
 		}
-		return QByteArray();
 	}
-	static bool isValidPacket(const QByteArray & packet)
+	/* retrieves the payload of the next valid packet received; returns false if no packets are available */
+	bool nextPacket(QByteArray & packet_payload)
+	{
+		if (packets.empty())
+			return false;
+		packet_payload = packets.front();
+		packets.pop_front();
+		return true;
+	}
+	/* returns the next acknowledgment ('+' or '-') received, or 0, if none is available */
+	int nextAcknowledgment(void)
 	{
-		bool ok; int l; int c;
-		return ((l = packet.length()) < 4 || packet[0] != '$' || packet[l - 3] != '#' || (c = packet.mid(l - 2).toInt(& ok, 16), ! ok)
-			|| c != checksum(packet.mid(1, l - 4))) ? false : true;
+		if (acknowledgments.empty())
+			return 0;
+		int c = acknowledgments.front();
+		acknowledgments.pop_front();
+		return c;
 	}
-	static int errorCode(const QByteArray & reply) { if (!isValidPacket(reply) || reply.length() != 7 || reply[1] != 'E') return -1; return (reply.mid(2, 2).toInt(0, 16)); }
+	/* returns the number of invalid packets received since the last call */
+	int takeInvalidPacketCount(void) { int x = invalid_packet_count; invalid_packet_count = 0; return x; }
+	/* measures the framer throughput over large packets, and prints the results; defined in file 'gdb-remote.cxx' */
+	static void benchmark(void);
+};
+
+/* Note: all functions below that operate on packets received from the remote side expect
+ * packet payloads, as extracted by class 'GdbRemotePacketFramer' above */
+class GdbRemote
+{
+private:
+	friend class GdbRemotePacketFramer;
+	/* Replies from a remote stub must also escape the '*' character, because in replies,
+	 * it starts a run-length encoding sequence */
+	static QByteArray escape(const QByteArray & data, bool is_reply = false)
+	{
+		QByteArray x;
+		x.reserve(data.length() + (data.length() >> 4) + 1);
+		for (auto c : data)
+			if (c == '}' || c == '#' || c == '$' || (is_reply && c == '*'))
+				x.append('}'), x.append((char) (c ^ 0x20));
+			else
+				x.append(c);
+		return x;
+	}
+	static int checksum(const QByteArray & data) { unsigned char x = 0; for (auto c : data) x += c; return x; }
+	static QByteArray makePacket(const QByteArray & data, bool is_reply = false)
+	{
+		auto x = escape(data, is_reply);
+		return QByteArray("$") + x + "#" + QByteArray::number(checksum(x) | 0x100, 16).right(2);
+	}
+	static QByteArray makeReplyPacket(const QByteArray & data) { return makePacket(data, true); }
+public:
+	static int errorCode(const QByteArray & reply) { bool ok; int x; if (reply.length() != 3 || reply[0] != 'E' || (x = reply.mid(1).toInt(& ok, 16), !ok)) return -1; return x; }
 	static bool isErrorResponse(const QByteArray & reply) { return errorCode(reply) != -1
 		||	/* failed monitor commands as of now (29072017) return a single 'E' character packet, without an error code...
 			 * maybe this should be fixed in the blackmagic probe? special-case this case here... */
-				packetData(reply) == "E"; }
-	static bool isOkResponse(const QByteArray & data) { return data.toLower().operator ==(makePacket("OK").toLower()); }
-	static bool isEmptyResponse(const QByteArray & data) { return data.toLower().operator ==(makePacket("").toLower()); }
-	static QByteArray packetData(const QByteArray & packet) { if (isValidPacket(packet)) return strip(packet); return QByteArray(); }
+				reply == "E"; }
+	static bool isOkResponse(const QByteArray & reply) { return reply == "OK"; }
+	/* Returns the signal number in a 'T' or 'S' stop reply packet, or the exit status/terminating
+	 * signal number in a 'W' or 'X' stop reply packet; returns -1 if the packet is not a stop reply */
+	static int stopReplySignal(const QByteArray & reply) { bool ok; int x; if (reply.length() < 3 || !QByteArray("TSWX").contains(reply[0]) || (x = reply.mid(1, 2).toInt(& ok, 16), !ok)) return -1; return x; }
+	/* returns true for 'W' and 'X' stop reply packets, which report that the target process has terminated */
+	static bool isTerminationStopReply(const QByteArray & reply) { return stopReplySignal(reply) != -1 && (reply[0] == 'W' || reply[0] == 'X'); }
+	static bool isEmptyResponse(const QByteArray & reply) { return reply.isEmpty(); }
 	static QByteArray monitorRequest(const QString & request) { return makePacket((QByteArray("qRcmd,") + request.toLocal8Bit().toHex())); }
 	static QByteArray readRegistersRequest(void) { return makePacket("g"); }
 	static QByteArray attachRequest(void) { return makePacket("vAttach;1"); }
+	static QByteArray startNoAckModeRequest(void) { return makePacket("QStartNoAckMode"); }
+	static QByteArray supportedFeaturesRequest(void) { return makePacket("qSupported"); }
+	static QByteArray currentThreadRequest(void) { return makePacket("qC"); }
+	static bool isCurrentThreadResponse(const QByteArray & response) { return response.startsWith("QC"); }
+	/* Parses a 'qSupported' reply. For features of the form 'name=value', the value is stored
+	 * in the returned hash; for features of the form 'name+', 'name-' and 'name?', the
+	 * single character suffix is stored */
+	static QHash<QByteArray, QByteArray> supportedFeatures(const QByteArray & reply)
+	{
+		QHash<QByteArray, QByteArray> features;
+		auto x = reply.split(';');
+		for (const auto & feature : x)
+		{
+			int i = feature.indexOf('=');
+			if (i != -1)
+				features.insert(feature.left(i), feature.mid(i + 1));
+			else if (feature.length() > 1 && (feature.endsWith('+') || feature.endsWith('-') || feature.endsWith('?')))
+				features.insert(feature.left(feature.length() - 1), feature.right(1));
+		}
+		return features;
+	}
 	static QByteArray memoryMapReadRequest(void) { return makePacket("qXfer:memory-map:read::0,400"); }
 	static QByteArray singleStepRequest(void) { return makePacket("s"); }
 	static QByteArray continueRequest(void) { return makePacket("c"); }
@@ -74,23 +245,18 @@ public:
 	static QByteArray removeHardwareBreakpointRequest(uint32_t address, int length) { return makePacket(QString("z1,%1,%2").arg(address, 0, 16).arg(length).toLocal8Bit()); }
 	static QByteArray memoryMapReadData(const QByteArray & reply)
 	{
-		if (!isValidPacket(reply))
+		if (!reply.length() || reply[0] != 'm')
 			Util::panic();
-		auto x = strip(reply);
-		if (!x.length() || x[0] != 'm')
-			Util::panic();
-		return x.mid(1);
+		return reply.mid(1);
 	}
 	static QVector<uint32_t> readRegisters(const QByteArray & reply)
 	{
 		QVector<uint32_t> registers;
-		if (!isValidPacket(reply)) Util::panic();
 		int i;
-		auto x = strip(reply);
-		if (x.length() & 7) Util::panic();
-		for (i = 0; i < x.length() >> 3; i ++)
+		if (reply.length() & 7) Util::panic();
+		for (i = 0; i < reply.length() >> 3; i ++)
 		{
-			uint32_t r = x.mid(i << 3, 8).toUInt(0, 16);
+			uint32_t r = reply.mid(i << 3, 8).toUInt(0, 16);
 			/* fix endianness */
 			r = ((r & 0xffff) << 16) | (r >> 16);
 			r = ((r & 0x00ff00ff) << 8) | ((r & 0xff00ff00) >> 8);
@@ -98,17 +264,29 @@ public:
 		}
 		return registers;
 	}
-	static QVector<QByteArray> readMemoryRequest(uint32_t address, uint32_t length, int chunk_size = 500)
+	/* if 'is_binary' is true, binary memory read ('x') requests are generated, otherwise - hex memory read ('m') requests */
+	static QVector<QByteArray> readMemoryRequest(uint32_t address, uint32_t length, int chunk_size = 500, bool is_binary = false)
 	{
 		QVector<QByteArray> packets;
 		while (length)
 		{
 			int x = Util::min(length, (unsigned) chunk_size);
-			packets.push_back(makePacket(QString("m%1,%2").arg(address, 0, 16).arg(x, 0, 16).toLocal8Bit()));
+			packets.push_back(makePacket(QString("%1%2,%3").arg(is_binary ? 'x' : 'm').arg(address, 0, 16).arg(x, 0, 16).toLocal8Bit()));
 			length -= x, address += x;
 		}
 		return packets;
 	}
+	/* decodes the data in a single reply to a memory read request; binary memory read replies are
+	 * prefixed with a 'b' character (escaped bytes have already been decoded by the packet framer);
+	 * note that a reply may contain less data than requested */
+	static QByteArray readMemoryData(const QByteArray & reply, bool is_binary = false)
+	{
+		if (!is_binary)
+			return QByteArray::fromHex(reply);
+		if (!reply.length() || reply[0] != 'b')
+			return QByteArray();
+		return reply.mid(1);
+	}
 	static QByteArray readMemory(const QVector<QByteArray> & reply)
 	{
 		QByteArray data;
@@ -117,33 +295,62 @@ public:
 		{
 			if (reply[i][0] == 'E')
 				return QByteArray();
-			data += QByteArray::fromHex(packetData(reply[i]));
+			data += QByteArray::fromHex(reply[i]);
 		}
 		return data;
 	}
-	static QVector<QByteArray> writeFlashMemoryRequest(uint32_t address, uint32_t length, const QByteArray & data, int chunk_size = 500)
+	static QVector<QByteArray> writeFlashMemoryRequest(uint32_t address, uint32_t length, const QByteArray & data, int max_payload_size = 500)
+	{
+		QVector<QByteArray> packets = flashWriteRequests(address, data.left(length), max_payload_size);
+		packets.push_back(flashDoneRequest());
+		return packets;
+	}
+	/* 'vFlashWrite' requests only; when writing several memory ranges, all 'vFlashWrite' requests
+	 * must be sent before a single, final 'vFlashDone' request. Each request packet is filled
+	 * with as much data as fits in 'max_payload_size' bytes after escaping. If 'chunk_sizes'
+	 * is not null, the number of data bytes in each request is stored in it */
+	static QVector<QByteArray> flashWriteRequests(uint32_t address, const QByteArray & data, int max_payload_size, QVector<int> * chunk_sizes = 0)
 	{
 		QVector<QByteArray> packets;
-		int i = 0;
-		while (length)
+		int i = 0, j, payload_size;
+		while (i < data.size())
 		{
-			int x = Util::min(length, (unsigned) chunk_size);
-			packets.push_back(makePacket(QString("vFlashWrite:%1:").arg(address, 0, 16).toLocal8Bit() + data.mid(i, x)));
-			length -= x, address += x, i += x;
+			auto header = QString("vFlashWrite:%1:").arg(address + i, 0, 16).toLocal8Bit();
+			for (payload_size = header.size(), j = i; j < data.size(); j ++)
+			{
+				int x = (data[j] == '}' || data[j] == '#' || data[j] == '$') ? 2 : 1;
+				if (payload_size + x > max_payload_size && j > i)
+					break;
+				payload_size += x;
+			}
+			packets.push_back(makePacket(header + data.mid(i, j - i)));
+			if (chunk_sizes)
+				chunk_sizes->push_back(j - i);
+			i = j;
 		}
-		packets.push_back(makePacket(QByteArray("vFlashDone")));
 		return packets;
 	}
+	static QByteArray flashDoneRequest(void) { return makePacket(QByteArray("vFlashDone")); }
+	static QByteArray crcRequest(uint32_t address, uint32_t length) { return makePacket(QString("qCRC:%1,%2").arg(address, 0, 16).arg(length, 0, 16).toLocal8Bit()); }
+	/* parses a 'qCRC' reply, of the form 'Cxxxxxxxx'; returns false for error, and empty (i.e., unsupported request) replies */
+	static bool crcValue(const QByteArray & reply, uint32_t & crc)
+	{
+		bool ok;
+		if (reply.length() < 2 || reply[0] != 'C')
+			return false;
+		crc = reply.mid(1).toUInt(& ok, 16);
+		return ok;
+	}
 	static QByteArray eraseFlashMemoryRequest(uint32_t address, uint32_t length) { return makePacket(QString("vFlashErase:%1,%2").arg(address, 0, 16).arg(length, 0, 16).toLocal8Bit()); }
 
 
 	/* GDB response packets. Used when running a gdbserver, these are responses returned to an external gdb client */
-	static QByteArray rawResponsePacket(const QString& rawData) { return makePacket(rawData.toLocal8Bit()); }
-	static QByteArray emptyResponsePacket(void) { return makePacket(""); }
-	static QByteArray okResponsePacket(void) { return makePacket("OK"); }
-	static QByteArray stopReplySignalNumberPacket(int signal_number) { return makePacket(QString("T%1").arg(signal_number & 0xff, 2, 16, QChar('0')).toUpper().toLocal8Bit()); }
-	static QByteArray targetExitedExitcodeNumberPacket(int target_exit_code) { return makePacket(QString("W%1").arg(target_exit_code & 0xff, 2, 16, QChar('0')).toUpper().toLocal8Bit()); }
-	static QByteArray errorReplyPacket(int error_code) { return makePacket(QString("E%1").arg(error_code & 0xff, 2, 16, QChar('0')).toUpper().toLocal8Bit()); }
+	static QByteArray rawResponsePacket(const QString& rawData) { return makeReplyPacket(rawData.toLocal8Bit()); }
+	static QByteArray emptyResponsePacket(void) { return makeReplyPacket(""); }
+	static QByteArray okResponsePacket(void) { return makeReplyPacket("OK"); }
+	static QByteArray stopReplySignalNumberPacket(int signal_number) { return makeReplyPacket(QString("T%1").arg(signal_number & 0xff, 2, 16, QChar('0')).toUpper().toLocal8Bit()); }
+	static QByteArray targetExitedExitcodeNumberPacket(int target_exit_code) { return makeReplyPacket(QString("W%1").arg(target_exit_code & 0xff, 2, 16, QChar('0')).toUpper().toLocal8Bit()); }
+	static QByteArray errorReplyPacket(int error_code) { return makeReplyPacket(QString("E%1").arg(error_code & 0xff, 2, 16, QChar('0')).toUpper().toLocal8Bit()); }
 
 };
 
@@ -22,6 +22,7 @@ THE SOFTWARE.
 
 #include <QDebug>
 #include <QMessageBox>
+#include <QRegularExpression>
 
 #include "gdbserver.hxx"
 #include "gdb-remote.hxx"
@@ -70,7 +71,7 @@ GdbServer::GdbServer(Target *target)
 
 void GdbServer::handleGdbPacket(const QByteArray &packet)
 {
-	auto pd = GdbRemote::packetData(packet);
+	auto & pd = packet;
 	if (pd.startsWith("qSupported"))
 		sendGdbReply(GdbRemote::rawResponsePacket("qXfer:features:read+"));
 	else if (pd.startsWith("!"))
@@ -141,26 +142,32 @@ void GdbServer::newConneciton(void)
 {
 	qDebug() << "gdb client connected";
 	gdb_client_socket = gdb_tcpserver.nextPendingConnection();
+	framer.reset();
+	last_reply.clear();
 	connect(gdb_client_socket, &QTcpSocket::disconnected, [&] { gdb_client_socket->disconnect(); gdb_client_socket = 0; qDebug() << "gdb client disconnected"; });
 	connect(gdb_client_socket, SIGNAL(readyRead()), this, SLOT(gdbClientSocketReadyRead()));
 }
 
 void GdbServer::gdbClientSocketReadyRead(void)
 {
-	incoming_data += gdb_client_socket->readAll();
-	QByteArray packet;
-	while ((packet = GdbRemote::extractPacket(incoming_data)).length())
+	framer.feed(gdb_client_socket->readAll());
+	for (auto i = framer.takeInvalidPacketCount(); i; i --)
 	{
-		qDebug() << "Received gdb packet:" << packet;
-		if (!GdbRemote::isValidPacket(packet))
-		{
-			qDebug() << "Invalid gdb packet received:" << packet;
-			gdb_client_socket->write("-");
-		}
-		else
+		qDebug() << "Invalid gdb packet received";
+		gdb_client_socket->write("-");
+	}
+	int c;
+	while ((c = framer.nextAcknowledgment()))
+		if (c == '-' && !last_reply.isEmpty())
 		{
-			gdb_client_socket->write("+");
-			handleGdbPacket(packet);
+			qDebug() << "Retransmitting last reply";
+			gdb_client_socket->write(last_reply);
 		}
+	QByteArray packet;
+	while (gdb_client_socket && framer.nextPacket(packet))
+	{
+		qDebug() << "Received gdb packet:" << packet;
+		gdb_client_socket->write("+");
+		handleGdbPacket(packet);
 	}
 }
@@ -45,9 +45,11 @@ private:
 	Target		* target;
 	QTcpServer	gdb_tcpserver;
 	QTcpSocket	* gdb_client_socket = 0;
-	QByteArray	incoming_data;
+	GdbRemotePacketFramer	framer;
+	/* the last reply sent, retransmitted if the gdb client requests so */
+	QByteArray	last_reply;
 	void		handleGdbPacket(const QByteArray& packet);
-	void		sendGdbReply(const QByteArray& packet) { qDebug() << "Sending reply:" << packet; gdb_client_socket->write(packet); }
+	void		sendGdbReply(const QByteArray& packet) { qDebug() << "Sending reply:" << packet; gdb_client_socket->write(last_reply = packet); }
 	static const QByteArray cortexmTargetDescriptionXml;
 private slots:
 	void newConneciton(void);
@@ -0,0 +1,183 @@
+/*
+Copyright (c) 2019 stoyan shopov
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+#ifndef INTELHEXMEMORYDATA_H
+#define INTELHEXMEMORYDATA_H
+
+#include <string.h>
+#include <QFile>
+#include <QDebug>
+#include <QElapsedTimer>
+#include "memory.hxx"
+#include "util.hxx"
+
+
+/* Loads Intel HEX files. The file is parsed in place, record checksums are validated, and
+ * contiguous data records are accumulated before being added to the memory contents */
+class IntelHexMemoryData
+{
+private:
+	enum
+	{
+		DATA_RECORD				= 0,
+		END_OF_FILE_RECORD			= 1,
+		EXTENDED_SEGMENT_ADDRESS_RECORD		= 2,
+		START_SEGMENT_ADDRESS_RECORD		= 3,
+		EXTENDED_LINEAR_ADDRESS_RECORD		= 4,
+		START_LINEAR_ADDRESS_RECORD		= 5,
+	};
+public:
+	static bool loadFile(const QString & filename, Memory & memory, QString * error_message = 0)
+	{
+		QFile f(filename);
+		if (!f.open(QFile::ReadOnly))
+		{
+			if (error_message)
+				* error_message = QString("cannot open file %1").arg(filename);
+			return false;
+		}
+		QByteArray contents;
+		const char * p = (const char *) f.map(0, f.size());
+		if (!p)
+		{
+			contents = f.readAll();
+			p = contents.constData();
+		}
+		return load(p, f.size(), memory, error_message);
+	}
+	static bool load(const char * s, qint64 size, Memory & memory, QString * error_message = 0)
+	{
+		const char * end = s + size, * line_end;
+		int line_number = 0;
+		uint32_t base_address = 0, data_address = 0;
+		QByteArray data;
+		unsigned char record[256 + 5];
+
+		for (; s < end; s = line_end + 1)
+		{
+			line_number ++;
+			if (!(line_end = (const char *) memchr(s, '\n', end - s)))
+				line_end = end;
+			int length = line_end - s;
+			while (length && (s[length - 1] == '\r' || s[length - 1] == ' ' || s[length - 1] == '\t'))
+				length --;
+			if (!length)
+				continue;
+			if (length < 11 || s[0] != ':')
+				return error(error_message, line_number, "malformed record");
+
+			int i, count = Util::hexByte(s + 1), sum = 0;
+			if (count < 0 || length != 11 + 2 * count)
+				return error(error_message, line_number, "invalid record length");
+			for (i = 0; i < count + 5; i ++)
+			{
+				int x = Util::hexByte(s + 1 + 2 * i);
+				if (x < 0)
+					return error(error_message, line_number, "invalid hexadecimal digit");
+				sum += (record[i] = x);
+			}
+			if (sum & 0xff)
+				return error(error_message, line_number, "checksum mismatch");
+
+			const unsigned char * payload = record + 4;
+			switch (record[3])
+			{
+				case DATA_RECORD:
+				{
+					uint32_t address = base_address + ((record[1] << 8) | record[2]);
+					if (address != data_address + data.size())
+					{
+						memory.addRange(data_address, data);
+						data.clear();
+						data_address = address;
+					}
+					data.append((const char *) payload, count);
+					break;
+				}
+				case END_OF_FILE_RECORD:
+					memory.addRange(data_address, data);
+					return true;
+				case EXTENDED_SEGMENT_ADDRESS_RECORD:
+				case EXTENDED_LINEAR_ADDRESS_RECORD:
+					if (count != 2)
+						return error(error_message, line_number, "invalid extended address record");
+					base_address = ((payload[0] << 8) | payload[1]) << (record[3] == EXTENDED_LINEAR_ADDRESS_RECORD ? 16 : 4);
+					break;
+				case START_SEGMENT_ADDRESS_RECORD:
+				case START_LINEAR_ADDRESS_RECORD:
+					break;
+				default:
+					return error(error_message, line_number, "unsupported record type");
+			}
+		}
+		memory.addRange(data_address, data);
+		return true;
+	}
+	/* Generates an Intel HEX file for a multi-megabyte memory image, and times loading it */
+	static void benchmark(void)
+	{
+		enum
+		{
+			IMAGE_ADDRESS		= 0x08000000,
+			IMAGE_SIZE		= 4 * 1024 * 1024,
+			RECORD_DATA_SIZE	= 32,
+		};
+		QByteArray image(IMAGE_SIZE, 0), file;
+		int i, j;
+		for (i = 0; i < IMAGE_SIZE; i ++)
+			image[i] = (char) (i * 7 + (i >> 11));
+
+		auto append_record = [&] (QByteArray record)
+		{
+			int sum = 0;
+			for (j = 0; j < record.size(); sum += (uint8_t) record.at(j ++));
+			file += ':' + (record + (char) - sum).toHex().toUpper() + "\r\n";
+		};
+		for (i = 0; i < IMAGE_SIZE; i += RECORD_DATA_SIZE)
+		{
+			uint32_t address = IMAGE_ADDRESS + i;
+			if (!i || !(address & 0xffff))
+				append_record(QByteArray(1, 2) + (char) 0 + (char) 0 + (char) EXTENDED_LINEAR_ADDRESS_RECORD + (char) (address >> 24) + (char) (address >> 16));
+			append_record(QByteArray(1, RECORD_DATA_SIZE) + (char) (address >> 8) + (char) address + (char) DATA_RECORD + image.mid(i, RECORD_DATA_SIZE));
+		}
+		file += ":00000001FF\r\n";
+
+		Memory memory;
+		QString error_message;
+		QElapsedTimer t;
+		t.start();
+		bool result = load(file.constData(), file.size(), memory, & error_message);
+		auto ns = t.nsecsElapsed();
+		qDebug() << "intel hex loader benchmark: file size" << file.size() << "bytes,"
+			 << (result ? "loaded" : "failed:") << error_message
+			 << (memory.data(IMAGE_ADDRESS, IMAGE_SIZE) == image ? "data matching," : "DATA MISMATCH,")
+			 << (ns ? file.size() * 1000. / ns : 0.) << "MB/s";
+	}
+private:
+	static bool error(QString * error_message, int line_number, const char * reason)
+	{
+		if (error_message)
+			* error_message = QString("line %1: %2").arg(line_number).arg(reason);
+		return false;
+	}
+};
+
+#endif // INTELHEXMEMORYDATA_H
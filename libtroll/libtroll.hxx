@@ -25,10 +25,20 @@ THE SOFTWARE.
 #include <dwarf.h>
 #include <stdint.h>
 #include <map>
+#include <set>
+#include <algorithm>
 #include <vector>
 #include <sstream>
 #include <QDebug>
+
+/* Define LIBTROLL_GUI_ENABLED to zero when building tools that do not link against the Qt widgets module */
+#ifndef LIBTROLL_GUI_ENABLED
+#define LIBTROLL_GUI_ENABLED	1
+#endif
+
+#if LIBTROLL_GUI_ENABLED
 #include <QMessageBox>
+#endif
 
 /*! \todo	Make this a function */
 #define HEX(x) QString("$%1").arg(x, 8, 16, QChar('0'))
@@ -1349,6 +1359,13 @@ public:
 		bool operator < (const struct lineAddress & rhs) const { return address < rhs.address; }
 	};
 	struct sourceFileNames { const char * file, * directory, * compilation_directory; };
+	/* a row of a line number table, covering addresses in the range [address; end_address) */
+	struct lineTableRow
+	{
+		uint32_t address, end_address, file, line;
+		bool is_stmt;
+		bool operator < (const struct lineTableRow & rhs) const { return address < rhs.address; }
+	};
 	DebugLine(const uint8_t * debug_line, uint32_t debug_line_len)
 	{ header = this->debug_line = debug_line, this->debug_line_len = debug_line_len; validateHeader(); }
 	/*! \todo	refactor here, the same code is duplicated several times with minor differences */
@@ -1609,6 +1626,101 @@ public:
 		}
 		return file_number = 0, -1;
 	}
+	/* Interprets the line number program at the offset passed just once, and appends all line number table
+	 * rows to 'rows', in line number program order; the rows are not sorted by address */
+	void lineTableRows(uint32_t statement_list_offset, std::vector<struct lineTableRow> & rows)
+	{
+		header = debug_line + statement_list_offset;
+		validateHeader();
+		const uint8_t * p(line_number_program()), op_base(opcode_base()), lrange(line_range());
+		int lbase(line_base());
+		uint32_t min_insn_length(minimum_instruction_length());
+		int len, x;
+		auto emit_row = [&] (void)
+		{
+			if (prev->address < current->address)
+				rows.push_back((struct lineTableRow) { .address = prev->address, .end_address = current->address,
+						.file = prev->file, .line = (uint32_t) prev->line, .is_stmt = (bool) prev->is_stmt, });
+		};
+		init();
+		while (p < header + sizeof(uint32_t) + unit_length())
+		{
+			if (! * p)
+			{
+				/* extended opcodes */
+				len = DwarfUtil::uleb128(++ p, & x);
+				p += x;
+				if (!len)
+					DwarfUtil::panic();
+				switch (* p ++)
+				{
+					default:
+						DwarfUtil::panic();
+					case DW_LNE_set_discriminator:
+						DwarfUtil::uleb128(p, & x);
+						if (len != x + 1) DwarfUtil::panic();
+						p += x;
+						break;
+					case DW_LNE_end_sequence:
+						if (len != 1) DwarfUtil::panic();
+						emit_row();
+						init();
+						break;
+					case DW_LNE_set_address:
+						if (len != 5) DwarfUtil::panic();
+						current->address = * (uint32_t *) p;
+						p += sizeof current->address;
+						break;
+				}
+			}
+			else if (* p >= op_base)
+			{
+				/* special opcodes */
+				uint8_t x = * p ++ - op_base;
+				current->address += (x / lrange) * min_insn_length;
+				current->line += lbase + x % lrange;
+				emit_row();
+				swap();
+				* current = * prev;
+			}
+			/* standard opcodes */
+			else switch (* p ++)
+			{
+				default:
+					DwarfUtil::panic();
+					break;
+				case DW_LNS_set_prologue_end:
+					break;
+				case DW_LNS_copy:
+					emit_row();
+					swap();
+					* current = * prev;
+					break;
+				case DW_LNS_advance_pc:
+					current->address += DwarfUtil::uleb128(p, & len) * min_insn_length;
+					p += len;
+					break;
+				case DW_LNS_advance_line:
+					current->line += DwarfUtil::sleb128(p, & len);
+					p += len;
+					break;
+				case DW_LNS_const_add_pc:
+					current->address += ((255 - op_base) / lrange) * min_insn_length;
+					break;
+				case DW_LNS_set_file:
+					current->file = DwarfUtil::uleb128(p, & len);
+					p += len;
+					break;
+				case DW_LNS_set_column:
+					current->column = DwarfUtil::uleb128(p, & len);
+					p += len;
+					break;
+				case DW_LNS_negate_stmt:
+					current->is_stmt = ! current->is_stmt;
+					break;
+			}
+		}
+	}
 
 	void addressesForFile(uint32_t file_number, std::vector<struct lineAddress> & line_addresses)
 	{
@@ -2176,6 +2288,27 @@ private:
 				return last_searched_compilation_unit_range->compilation_unit_header_debug_info_offset;
 		return -1;
 	}
+	/* Used for batch address queries. Sorts the addresses passed, and groups them by compilation unit; returns pairs
+	 * of compilation unit header offsets and indices in the address vector passed, ordered by compilation unit, and
+	 * by address within each compilation unit. Addresses not covered by any compilation unit are dropped */
+	std::vector<std::pair<uint32_t, int> > addressIndicesByCompilationUnit(const std::vector<uint32_t> & addresses)
+	{
+		std::vector<int> order(addresses.size());
+		std::vector<std::pair<uint32_t, int> > indices;
+		int i;
+		for (i = 0; i < order.size(); i ++)
+			order[i] = i;
+		std::sort(order.begin(), order.end(), [&] (int a, int b) { return addresses[a] < addresses[b]; });
+		/* the last searched compilation unit is checked first, so looking up sorted addresses is cheap */
+		for (auto i : order)
+		{
+			uint32_t cu_offset = get_compilation_unit_debug_info_offset_for_address(addresses[i]);
+			if (cu_offset != -1)
+				indices.push_back(std::pair<uint32_t, int>(cu_offset, i));
+		}
+		std::stable_sort(indices.begin(), indices.end(), [] (const std::pair<uint32_t, int> & a, const std::pair<uint32_t, int> & b) { return a.first < b.first; });
+		return indices;
+	}
 	uint32_t compilation_unit_base_address(const struct Die & compilation_unit_die)
 	{
 		struct Abbreviation a(debug_abbrev + compilation_unit_die.abbrev_offset);
@@ -2436,6 +2569,115 @@ public:
 		return s;
 	}
 
+	/* Batch version of 'sourceCodeCoordinatesForAddress()', for resolving many addresses at once (e.g., when symbolizing
+	 * crash logs, or profiler samples); the results are in the order of the addresses passed. The addresses are sorted
+	 * and grouped by compilation unit, and the line number program of each compilation unit is interpreted just once.
+	 * Note: should line number table sequences overlap (as is the case for functions discarded by the linker, which are
+	 * all placed at address 0), this may select a different row than 'sourceCodeCoordinatesForAddress()' does */
+	std::vector<struct SourceCodeCoordinates> sourceCodeCoordinatesForAddresses(const std::vector<uint32_t> & addresses)
+	{
+		std::vector<struct SourceCodeCoordinates> coordinates(addresses.size());
+		std::vector<struct DebugLine::lineTableRow> rows;
+		std::map<uint32_t, struct DebugLine::sourceFileNames> file_names;
+		auto indices = addressIndicesByCompilationUnit(addresses);
+		int i, j, row;
+
+		for (i = 0; i < addresses.size(); i ++)
+			coordinates[i].address = addresses[i];
+		for (i = 0; i < indices.size(); i = j)
+		{
+			for (j = i + 1; j < indices.size() && indices[j].first == indices[i].first; j ++)
+				;
+			uint32_t cu_die_offset = indices[i].first + /* skip compilation unit header */ compilation_unit_header(debug_info + indices[i].first).header_length();
+			auto compilation_unit_die = dieForDieOffset(cu_die_offset);
+			if (compilation_unit_die.tag != DW_TAG_compile_unit)
+				DwarfUtil::panic();
+			Abbreviation a(debug_abbrev + compilation_unit_die.abbrev_offset);
+			auto x = a.dataForAttribute(DW_AT_stmt_list, debug_info + compilation_unit_die.offset);
+			if (!x.form)
+				continue;
+			const char * compilation_directory_name = coordinates[indices[i].second].compilation_directory_name;
+			auto d = a.dataForAttribute(DW_AT_comp_dir, debug_info + compilation_unit_die.offset);
+			if (d.form)
+				compilation_directory_name = DwarfUtil::formString(d.form, d.debug_info_bytes, debug_str);
+
+			class DebugLine l(debug_line, debug_line_len);
+			rows.clear(), file_names.clear();
+			l.lineTableRows(DwarfUtil::formConstant(x), rows);
+			std::sort(rows.begin(), rows.end());
+			/* both the addresses and the line number table rows are now sorted - sweep them together */
+			for (row = 0; i < j; i ++)
+			{
+				struct SourceCodeCoordinates & s(coordinates[indices[i].second]);
+				while (row + 1 < rows.size() && rows[row + 1].address <= s.address)
+					row ++;
+				s.compilation_directory_name = compilation_directory_name;
+				if (row >= rows.size() || s.address < rows[row].address || rows[row].end_address <= s.address)
+					continue;
+				auto f = file_names.find(rows[row].file);
+				if (f == file_names.end())
+				{
+					struct DebugLine::sourceFileNames n;
+					n.compilation_directory = compilation_directory_name;
+					l.stringsForFileNumber(rows[row].file, n.file, n.directory, compilation_directory_name);
+					f = file_names.insert(std::pair<uint32_t, struct DebugLine::sourceFileNames>(rows[row].file, n)).first;
+				}
+				s.line = rows[row].line, s.file_name = f->second.file, s.directory_name = f->second.directory;
+			}
+		}
+		return coordinates;
+	}
+	/* Batch version of 'executionContextForAddress()'; the results are in the order of the addresses passed. The addresses
+	 * are sorted and grouped by compilation unit, and the debug information entries read while resolving an address
+	 * are reused for resolving the following addresses in the same compilation unit, instead of being read again */
+	std::vector<std::vector<struct Die> > executionContextsForAddresses(const std::vector<uint32_t> & addresses)
+	{
+		std::vector<std::vector<struct Die> > contexts(addresses.size());
+		std::vector<struct Die> compilation_unit_die;
+		/* the children of the dies read so far in the current compilation unit, keyed by die offset */
+		std::map<uint32_t, std::vector<struct Die> > children_of_dies;
+		auto indices = addressIndicesByCompilationUnit(addresses);
+		int i, j;
+
+		for (i = 0; i < indices.size(); i ++)
+		{
+			uint32_t address = addresses[indices[i].second];
+			if (i && indices[i].first == indices[i - 1].first && address == addresses[indices[i - 1].second])
+			{
+				contexts[indices[i].second] = contexts[indices[i - 1].second];
+				continue;
+			}
+			if (!i || indices[i].first != indices[i - 1].first)
+			{
+				uint32_t cu_die_offset = indices[i].first + /* discard the compilation unit header */ compilation_unit_header(debug_info + indices[i].first).header_length();
+				compilation_unit_die = debug_tree_of_die(cu_die_offset, 0, 1);
+				children_of_dies.clear();
+			}
+			std::vector<struct Die> & context(contexts[indices[i].second]);
+			const std::vector<struct Die> * die_list(& compilation_unit_die);
+			j = 0;
+			while (j < die_list->size())
+				if (isAddressInRange(die_list->at(j), address, compilation_unit_die.at(0)))
+				{
+					uint32_t die_offset(die_list->at(j).offset);
+					auto children = children_of_dies.find(die_offset);
+					if (children == children_of_dies.end())
+					{
+						uint32_t x(die_offset);
+						children = children_of_dies.insert(std::pair<uint32_t, std::vector<struct Die> >(die_offset,
+								debug_tree_of_die(x, /* read only immediate die children */ 0, 2).at(0).children)).first;
+					}
+					context.push_back(die_list->at(j));
+					context.back().children = children->second;
+					die_list = & children->second;
+					j = 0;
+				}
+				else
+					j ++;
+		}
+		return contexts;
+	}
+
 	struct TypePrintFlags
 	{
 		bool	verbose_printing		: 1;
@@ -2867,10 +3109,14 @@ int baseTypeEncoding(const std::vector<struct DwarfTypeNode> & type, int node_nu
 	{
 		if (type_node_number == -1)
 		{
+#if LIBTROLL_GUI_ENABLED
 			QMessageBox::critical(0, "DWARF parser internal error",
 				    "Internal error when parsing DWARF type information:\n"
 				    "invalid type node index\n\n"
 				    "Please! Report this error");
+#else
+			qDebug() << "DWARF parser internal error: invalid type node index";
+#endif
 			return;
 		}
 
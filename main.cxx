@@ -20,10 +20,33 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
 THE SOFTWARE.
 */
 #include "troll.hxx"
+#include "crash-triage.hxx"
 #include <QApplication>
+#include <QCoreApplication>
+#include <string.h>
 
 int main(int argc, char *argv[])
 {
+	int i;
+	for (i = 1; i < argc; i ++)
+		if (!strcmp(argv[i], "--triage"))
+		{
+			/* headless batch crash triage - do not start the graphical user interface */
+			QCoreApplication a(argc, argv);
+			Util::isHeadless() = true;
+			return CrashTriage::run(a.arguments());
+		}
+		else if (!strcmp(argv[i], "--benchmark"))
+		{
+			/* run the benchmarks of the performance critical parts of the troll, and exit */
+			QCoreApplication a(argc, argv);
+			Util::isHeadless() = true;
+			GdbRemotePacketFramer::benchmark();
+			SRecordMemoryData::benchmark();
+			IntelHexMemoryData::benchmark();
+			return 0;
+		}
+
 	QApplication a(argc, argv);
 	MainWindow w;
 	w.show();
@@ -23,13 +23,14 @@ THE SOFTWARE.
 #define MEMORY_H
  
 #include <stdint.h>
+#include <algorithm>
 #include <QVector>
 #include <QByteArray>
 #include <QFile>
 #include <QApplication>
+#include <QTime>
 #include "target.hxx"
-
-#include "ui_notification.h"
+#include "crc32.hxx"
 
 struct memory_range
 {
@@ -39,62 +40,135 @@ struct memory_range
 
 class Memory
 {
+private:
+	/* Returns the index of the first memory range that ends at, or after, the address passed */
+	int firstRangeEndingAtOrAfter(uint64_t address) const
+	{
+		return std::lower_bound(ranges.cbegin(), ranges.cend(), address,
+			[] (const struct memory_range & range, uint64_t address) -> bool
+				{ return range.address + (uint64_t) range.data.size() < address; }) - ranges.cbegin();
+	}
+	/* Returns the index of the memory range containing the address passed, or -1 if there is no such range */
+	int rangeIndexForAddress(uint32_t address) const
+	{
+		int i = std::upper_bound(ranges.cbegin(), ranges.cend(), address,
+			[] (uint32_t address, const struct memory_range & range) -> bool
+				{ return address < range.address; }) - ranges.cbegin() - 1;
+		if (i < 0 || address >= ranges[i].address + (uint64_t) ranges[i].data.size())
+			return -1;
+		return i;
+	}
 public:
+	/* The memory ranges are kept sorted by address, they never overlap, and adjacent ranges are always
+	 * coalesced, so that any contiguous block of memory is always held in a single memory range */
 	QVector<struct memory_range> ranges;
+	/* Adds a memory range; where it overlaps already existing memory ranges, the newly added data takes precedence.
+	 * Adding ranges in ascending address order - which is the common case when loading images - takes amortized
+	 * constant time per range */
 	void addRange(uint32_t address, const QByteArray & data)
 	{
+		if (data.isEmpty())
+			return;
+		uint64_t end = address + (uint64_t) data.size();
+		if (ranges.isEmpty() || address > ranges.last().address + (uint64_t) ranges.last().data.size())
+		{
+			ranges.push_back((struct memory_range) { .address = address, .data = data, });
+			return;
+		}
+		if (address == ranges.last().address + (uint64_t) ranges.last().data.size())
+		{
+			ranges.last().data.append(data);
+			return;
+		}
+		/* the new range overlaps, or is adjacent to, the ranges in the [first; last) interval */
+		int first = firstRangeEndingAtOrAfter(address);
+		int last = std::upper_bound(ranges.cbegin() + first, ranges.cend(), end,
+			[] (uint64_t end, const struct memory_range & range) -> bool
+				{ return end < range.address; }) - ranges.cbegin();
+		if (first == last)
+		{
+			ranges.insert(first, (struct memory_range) { .address = address, .data = data, });
+			return;
+		}
+		struct memory_range & head = ranges[first];
+		const struct memory_range & tail = ranges[last - 1];
+		uint64_t tail_end = tail.address + (uint64_t) tail.data.size();
+		QByteArray x;
+		if (head.address < address)
+			x = head.data.left(address - head.address);
+		x.reserve(std::max(end, tail_end) - std::min((uint64_t) address, (uint64_t) head.address));
+		x += data;
+		if (tail_end > end)
+			x += tail.data.mid(end - tail.address);
+		head.address = std::min(address, head.address);
+		head.data = x;
+		ranges.remove(first + 1, last - first - 1);
+	}
+	/* Verifies that the target memory contents match the memory ranges. If the target supports it, checksums
+	 * of the memory ranges are computed on the target, and compared to the checksums of the memory ranges
+	 * computed here; target memory is only read back to localize a mismatch, or if the target does
+	 * not support computing checksums */
+	bool isMemoryMatching(class Target * target) const
+	{
+		enum
+		{
+			/* the memory ranges are verified in chunks of this size, so that computing a
+			 * single checksum on the target does not take too long */
+			VERIFY_CHUNK_SIZE	=	16 * 1024,
+		};
 		int i;
+		unsigned total = 0;
+		QVector<QPair<uint32_t, int> > chunks;
+		QVector<uint32_t> crcs;
+		QTime t;
+		t.start();
 		for (i = 0; i < ranges.size(); i ++)
-			if ((ranges[i].address <= address && address <= ranges[i].address + ranges[i].data.size())
-				|| (address <= ranges[i].address && ranges[i].address <= address + data.size()))
+			for (int offset = 0; offset < ranges[i].data.size(); offset += VERIFY_CHUNK_SIZE)
+				chunks.push_back(QPair<uint32_t, int>(ranges[i].address + offset, Util::min((int) VERIFY_CHUNK_SIZE, ranges[i].data.size() - offset))),
+				total += chunks.back().second;
+		target->reportFlashProgress(FLASH_VERIFY, 0, total, 0);
+		if (target->memoryCrcs(chunks, crcs))
+		{
+			for (i = 0; i < chunks.size(); i ++)
 			{
-				/* regions overlap - coalesce */
-				QByteArray x;
-				if (address >= ranges[i].address)
+				auto x = data(chunks[i].first, chunks[i].second);
+				if (Crc32::crc32(x.constData(), x.size()) != crcs[i])
 				{
-					x = ranges[i].data.left(address - ranges[i].address);
-					x += data;
-					address = ranges[i].address;
+					reportMismatch(chunks[i].first, x, target->readBytes(chunks[i].first, chunks[i].second, true));
+					return false;
 				}
-				else
-					x = data + ranges[i].data.right(ranges[i].data.size() - ((address + data.size()) - ranges[i].address));
-				ranges[i] = (struct memory_range) { .address = address, .data = x, };
-				auto s = ranges[i];
-				ranges.removeAt(i);
-				addRange(s.address, s.data);
-				return;
 			}
-		ranges.push_back((struct memory_range) { .address = address, .data = data, });
+			qDebug() << "target memory verified with checksums in" << t.elapsed() << "milliseconds";
+			target->reportFlashProgress(FLASH_VERIFY, total, total, t.elapsed());
+			return true;
+		}
+		qDebug() << "target side checksums not supported, reading back target memory";
+		auto x = target->readRanges(chunks);
+		for (i = 0; i < chunks.size(); i ++)
+		{
+			auto y = data(chunks[i].first, chunks[i].second);
+			if (x[i] != y)
+			{
+				reportMismatch(chunks[i].first, y, x[i]);
+				return false;
+			}
+		}
+		qDebug() << "target memory verified by reading it back in" << t.elapsed() << "milliseconds";
+		target->reportFlashProgress(FLASH_VERIFY, total, total, t.elapsed());
+		return true;
 	}
-	bool isMemoryMatching(class Target * target) const
+	static void reportMismatch(uint32_t address, const QByteArray & expected_data, const QByteArray & target_data)
 	{
 		int i;
-		QDialog dialog;
-		Ui::Notification mbox;
-		mbox.setupUi(& dialog);
-		dialog.setWindowTitle("verifying target memory contents");
-		for (i = 0; i < ranges.size(); i ++)
+		if (target_data.size() != expected_data.size())
 		{
-			mbox.label->setText(QString("verifying target memory region\nstart address $%1, size $%2")
-			                    .arg(ranges[i].address, 0, 16)
-			                    .arg(ranges[i].data.size(), 0, 16));
-			dialog.show();
-			QApplication::processEvents();
-			auto x = target->readBytes(ranges[i].address, ranges[i].data.size());
-			qDebug() << x.size() << ranges[i].data.size();
-			
-			QFile f1("out1.bin");
-			f1.open(QFile::WriteOnly);
-			f1.write(x);
-			f1.close();
-			f1.setFileName("out2.bin");
-			f1.open(QFile::WriteOnly);
-			f1.write(ranges[i].data);
-			f1.close();
-			if (x != ranges[i].data)
-				return false;
+			qDebug() << "error reading target memory at address" << QString("$%1").arg(address, 8, 16, QChar('0'));
+			return;
 		}
-		return true;
+		for (i = 0; i < expected_data.size() && expected_data[i] == target_data[i]; i ++)
+			;
+		qDebug() << "target memory contents mismatch at address" << QString("$%1").arg(address + i, 8, 16, QChar('0'))
+			 << "expected" << expected_data.mid(i, 16).toHex() << "found" << target_data.mid(i, 16).toHex();
 	}
 	void dump(void) const
 	{
@@ -102,14 +176,33 @@ public:
 		for (i = 0; i < ranges.size(); i ++)
 			qDebug() << "memory range at" << ranges[i].address << "size" << ranges[i].data.size();
 	}
-	QByteArray data(uint32_t address, int length)
+	/* Returns the contents of memory starting at the address passed. If not all of the requested memory is available,
+	 * only the available contiguous block of memory at the start of the requested memory area is returned */
+	QByteArray data(uint32_t address, int length) const
 	{
-		int i;
-		for (i = 0; i < ranges.size(); i ++)
-			if (ranges[i].address <= address && address <= ranges[i].address + ranges[i].data.size())
-				return ranges[i].data.mid(address - ranges[i].address, length);
-		return QByteArray();
+		int i = rangeIndexForAddress(address);
+		if (i == -1)
+			return QByteArray();
+		return ranges[i].data.mid(address - ranges[i].address, length);
+	}
+	/* Same as 'data()', but does not copy the memory contents. The returned byte array is
+	 * only valid as long as this memory object is not modified or destroyed */
+	QByteArray view(uint32_t address, int length) const
+	{
+		int i = rangeIndexForAddress(address);
+		if (i == -1 || length <= 0)
+			return QByteArray();
+		uint32_t offset = address - ranges[i].address;
+		return QByteArray::fromRawData(ranges[i].data.constData() + offset, std::min(length, (int) (ranges[i].data.size() - offset)));
 	}
 };
 
+inline void Target::enableImmutableMemoryAreas(const Memory & memory_contents)
+{
+	int i;
+	clearImmutableMemoryAreas();
+	for (i = 0; i < memory_contents.ranges.size(); i ++)
+		addImmutableMemoryArea(memory_contents.ranges[i].address, memory_contents.ranges[i].data);
+}
+
 #endif // MEMORY_H
@@ -0,0 +1,262 @@
+/*
+Copyright (c) 2019 stoyan shopov
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+#include <QEventLoop>
+#include <QDebug>
+
+#include "probe-io.hxx"
+#include "util.hxx"
+
+#define PROBE_IO_DEBUG 0
+
+bool ProbeIo::open(const QString & transport_specification, int write_coalescing_limit, int read_batching_delay)
+{
+bool result = false;
+	QMetaObject::invokeMethod(this, [&]
+	{
+		transport = ProbeTransport::create(transport_specification, this);
+		if (!transport)
+			return;
+		if (write_coalescing_limit >= 0)
+			transport->setWriteCoalescingLimit(write_coalescing_limit);
+		if (read_batching_delay >= 0)
+			transport->setReadBatchingDelay(read_batching_delay);
+		if (!transport->open())
+		{
+			delete transport;
+			transport = 0;
+			return;
+		}
+		qDebug() << "probe connected through" << transport->description();
+		/* flush any stale data from a previous session */
+		transport->write("+++");
+		transport->waitForBytesWritten(500);
+		do
+			transport->waitForReadyRead(500);
+		while (transport->readAll().size() > 0);
+		framer.reset();
+		is_no_ack_mode = false;
+		is_resynchronizing = false;
+		framer.setIgnoringAcknowledgments(false);
+		reply_timer = new QTimer(this);
+		reply_timer->setSingleShot(true);
+		reply_timer->setInterval(REPLY_TIMEOUT_MS);
+		connect(reply_timer, SIGNAL(timeout()), this, SLOT(replyTimeout()));
+		connect(transport, SIGNAL(dataReceived()), this, SLOT(transportDataReceived()));
+		connect(transport, SIGNAL(connectionLost()), this, SLOT(transportConnectionLost()));
+		result = true;
+	}, Qt::BlockingQueuedConnection);
+	return result;
+}
+
+void ProbeIo::close(void)
+{
+	QMetaObject::invokeMethod(this, [&]
+	{
+		if (transport)
+		{
+			transport->disconnect(this);
+			transport->close();
+		}
+		delete transport;
+		transport = 0;
+		while (!requests.empty())
+			completeRequest(true);
+		delete reply_timer;
+		reply_timer = 0;
+	}, Qt::BlockingQueuedConnection);
+}
+
+std::future<ProbeIo::Reply> ProbeIo::submit(const QVector<QByteArray> & packets, int pipeline_depth, bool is_console_output_expected)
+{
+	auto request = std::make_shared<struct Request>();
+	request->packets = packets;
+	request->pipeline_depth = Util::max(pipeline_depth, 1);
+	request->is_console_output_expected = is_console_output_expected;
+	auto future = request->promise.get_future();
+	QMetaObject::invokeMethod(this, [this, request] { requests.push_back(request); processRequests(); }, Qt::QueuedConnection);
+	return future;
+}
+
+void ProbeIo::post(const QByteArray & packet)
+{
+	QMetaObject::invokeMethod(this, [this, packet] { write(last_packet = packet); flush(); }, Qt::QueuedConnection);
+}
+
+void ProbeIo::interrupt(void)
+{
+	QMetaObject::invokeMethod(this, [this] { write("\003"); flush(); }, Qt::QueuedConnection);
+}
+
+void ProbeIo::setNoAckMode(bool is_enabled)
+{
+	QMetaObject::invokeMethod(this, [this, is_enabled] { framer.setIgnoringAcknowledgments(is_no_ack_mode = is_enabled); }, Qt::QueuedConnection);
+}
+
+ProbeIo::Reply ProbeIo::wait(std::future<Reply> future)
+{
+QEventLoop loop;
+	QObject::connect(this, & ProbeIo::requestCompleted, & loop, & QEventLoop::quit, Qt::QueuedConnection);
+	while (future.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+		loop.exec(QEventLoop::ExcludeUserInputEvents);
+	return future.get();
+}
+
+void ProbeIo::write(const QByteArray & data)
+{
+	if (PROBE_IO_DEBUG) qDebug() << "--> " << data;
+	if (transport)
+		transport->write(data);
+}
+
+void ProbeIo::flush(void)
+{
+	if (transport)
+		transport->flush();
+}
+
+void ProbeIo::processRequests(void)
+{
+	if (is_resynchronizing && transport)
+		return;
+	while (!requests.empty())
+	{
+		auto request = requests.front();
+		if (!transport || request->packets.isEmpty())
+		{
+			completeRequest(!transport);
+			continue;
+		}
+		int depth = is_no_ack_mode ? request->pipeline_depth : 1;
+		while (request->sent_count < request->packets.size() && request->sent_count - request->reply_count < depth)
+			write(last_packet = request->packets.at(request->sent_count ++));
+		/* all request packets that can be sent now go out with a single write */
+		flush();
+		if (!reply_timer->isActive())
+			reply_timer->start();
+		break;
+	}
+}
+
+void ProbeIo::completeRequest(bool is_timed_out)
+{
+	auto request = requests.front();
+	requests.pop_front();
+	if (reply_timer)
+		reply_timer->stop();
+	request->reply.is_timed_out = is_timed_out;
+	request->promise.set_value(request->reply);
+	emit requestCompleted();
+}
+
+void ProbeIo::transportDataReceived(void)
+{
+QByteArray payload;
+int c;
+auto timestamp = transport->receiveTimestamp();
+	framer.feed(transport->readAll());
+	for (c = framer.takeInvalidPacketCount(); c; c --)
+	{
+		qDebug() << "invalid packet received from the probe";
+		if (!is_no_ack_mode)
+			write("-");
+	}
+	while ((c = framer.nextAcknowledgment()))
+		if (c == '-' && !last_packet.isEmpty())
+		{
+			qDebug() << "probe requested packet retransmission";
+			write(last_packet);
+		}
+	while (framer.nextPacket(payload))
+	{
+		if (PROBE_IO_DEBUG) qDebug() << "<-- " << payload;
+		if (!is_no_ack_mode)
+			write("+");
+		if (is_resynchronizing && GdbRemote::stopReplySignal(payload) == -1)
+		{
+			if (GdbRemote::isCurrentThreadResponse(payload))
+				is_resynchronizing = false, reply_timer->stop();
+			else
+				qDebug() << "discarding late reply from the probe:" << payload;
+			continue;
+		}
+		if (requests.empty() || !requests.front()->sent_count)
+		{
+			/* not a reply to a request */
+			int signal_number = GdbRemote::stopReplySignal(payload);
+			if (signal_number != -1)
+				emit stopReplyReceived(payload, signal_number, timestamp);
+			else
+				emit packetReceived(payload);
+			continue;
+		}
+		auto request = requests.front();
+		request->reply.packets.push_back(payload);
+		if (request->is_console_output_expected && isConsoleOutputPacket(payload))
+			continue;
+		if (GdbRemote::isErrorResponse(payload))
+			/* Replies are matched to requests in order, so the replies to the requests still
+			 * in flight are valid - fall back to stop-and-wait mode for the rest of the requests */
+			request->pipeline_depth = 1;
+		if (++ request->reply_count == request->packets.size())
+			completeRequest(false);
+	}
+	if (!requests.empty() && !is_resynchronizing)
+		/* progress has been made - restart the reply timeout */
+		reply_timer->start();
+	processRequests();
+	/* send any acknowledgments and retransmissions */
+	flush();
+}
+
+void ProbeIo::transportConnectionLost(void)
+{
+	qDebug() << "probe connection lost";
+	transport->disconnect(this);
+	transport->deleteLater();
+	transport = 0;
+	while (!requests.empty())
+		completeRequest(true);
+	emit connectionLost();
+}
+
+void ProbeIo::replyTimeout(void)
+{
+	if (is_resynchronizing)
+	{
+		/* the probe is not responding at all - give up resynchronizing, and let subsequent requests time out on their own */
+		qDebug() << "timeout resynchronizing with the probe";
+		is_resynchronizing = false;
+		framer.reset();
+		processRequests();
+		return;
+	}
+	if (requests.empty())
+		return;
+	qDebug() << "timeout waiting for a reply from the probe";
+	/* discard any partially received data */
+	framer.reset();
+	completeRequest(true);
+	is_resynchronizing = true;
+	write(last_packet = GdbRemote::currentThreadRequest());
+	flush();
+	reply_timer->start();
+}
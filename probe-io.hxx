@@ -0,0 +1,121 @@
+/*
+Copyright (c) 2019 stoyan shopov
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+#ifndef PROBEIO_HXX
+#define PROBEIO_HXX
+
+#include <QObject>
+#include <QTimer>
+#include <QVector>
+#include <QByteArray>
+#include <deque>
+#include <memory>
+#include <future>
+
+#include "gdb-remote.hxx"
+#include "target.hxx"
+#include "probe-transport.hxx"
+
+/* Probe input/output worker. A probe input/output object is intended to live in a dedicated thread,
+ * and owns the transport to a gdb remote serial protocol probe. Requests are submitted from the
+ * front-end (gui) thread, are queued and processed in the probe input/output thread, and their
+ * completion is signalled by means of a 'std::future'. Packets received from the probe while no
+ * request is being processed are delivered to the front-end with the 'packetReceived()' signal,
+ * except for stop replies, which are parsed as soon as they are received, timestamped, and
+ * delivered with the 'stopReplyReceived()' signal */
+class ProbeIo : public QObject
+{
+	Q_OBJECT
+public:
+	struct Reply
+	{
+		/* the payloads of the packets received in reply to a request, in order */
+		QVector<QByteArray> packets;
+		bool is_timed_out = false;
+	};
+	enum
+	{
+		/* maximum time to wait for data from the probe, while processing a request */
+		REPLY_TIMEOUT_MS	= 2000,
+	};
+	/* Note: all public functions below are thread-safe, and are intended to be called from the front-end thread */
+	/* 'transport_specification' is as accepted by 'ProbeTransport::create()'; the write coalescing
+	 * limit and read batching delay are only applied if nonnegative */
+	bool open(const QString & transport_specification, int write_coalescing_limit = -1, int read_batching_delay = -1);
+	void close(void);
+	/* Submits (already framed) request packets for sending to the probe. Up to 'pipeline_depth' requests are kept
+	 * in flight (in no-acknowledgment mode only), and if the probe responds with an error, the remaining requests
+	 * are sent in stop-and-wait mode. Every request packet is expected to produce exactly one reply packet; if
+	 * 'is_console_output_expected' is true, console output packets (e.g., as sent in response to monitor commands)
+	 * are also stored in the reply, but are not counted as replies to requests. Note that binary memory read
+	 * replies may legitimately start with an 'O' character, so console output is not detected by default */
+	std::future<Reply> submit(const QVector<QByteArray> & requests, int pipeline_depth = 1, bool is_console_output_expected = false);
+	/* sends a packet, for which no reply is expected (e.g., continue and single step requests) */
+	void post(const QByteArray & packet);
+	/* sends an interrupt request (a 0x03 byte) to the probe */
+	void interrupt(void);
+	void setNoAckMode(bool is_enabled);
+	/* Waits for the completion of a request. While waiting, events other than user input events are
+	 * still being processed in the calling thread, so that the user interface does not freeze. Note that
+	 * the nested event loop makes the caller reentrant - slots of objects living in the calling thread
+	 * (e.g., timer and socket handlers) may run, and submit their own requests, before this returns */
+	Reply wait(std::future<Reply> future);
+	static bool isConsoleOutputPacket(const QByteArray & payload) { return payload.startsWith('O') && payload != "OK"; }
+signals:
+	void packetReceived(QByteArray payload);
+	/* 'signal_number' is as returned by 'GdbRemote::stopReplySignal()', 'timestamp' is as returned by 'Target::timestamp()',
+	 * and is taken when the data containing the stop reply is read from the probe */
+	void stopReplyReceived(QByteArray payload, int signal_number, qint64 timestamp);
+	void connectionLost(void);
+	void requestCompleted(void);
+private:
+	struct Request
+	{
+		QVector<QByteArray> packets;
+		int pipeline_depth;
+		bool is_console_output_expected;
+		int sent_count = 0, reply_count = 0;
+		struct Reply reply;
+		std::promise<struct Reply> promise;
+	};
+	/* all members below are only accessed in the probe input/output thread */
+	ProbeTransport	* transport = 0;
+	QTimer		* reply_timer = 0;
+	GdbRemotePacketFramer	framer;
+	std::deque<std::shared_ptr<struct Request> > requests;
+	/* the last packet sent, retransmitted if the probe requests so */
+	QByteArray	last_packet;
+	bool		is_no_ack_mode = false;
+	/* Set after a reply timeout. Replies to the requests that were in flight may still arrive late, and would
+	 * be mismatched to subsequent requests, so a request with a distinctive reply ('qC') is sent, all packets
+	 * received before its reply are discarded, and no other requests are sent until then */
+	bool		is_resynchronizing = false;
+	void write(const QByteArray & data);
+	void flush(void);
+	void processRequests(void);
+	void completeRequest(bool is_timed_out);
+private slots:
+	void transportDataReceived(void);
+	void transportConnectionLost(void);
+	void replyTimeout(void);
+};
+
+#endif // PROBEIO_HXX
@@ -0,0 +1,83 @@
+/*
+Copyright (c) 2019 stoyan shopov
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+#include "probe-transport.hxx"
+
+ProbeTransport * ProbeTransport::create(const QString & specification, QObject * parent)
+{
+	if (specification.startsWith("tcp:"))
+	{
+		int i = specification.lastIndexOf(':');
+		bool ok;
+		unsigned port_number = specification.mid(i + 1).toUInt(& ok);
+		if (i <= 4 || !ok || port_number > 0xffff)
+			return 0;
+		return new TcpProbeTransport(specification.mid(4, i - 4), port_number, parent);
+	}
+	if (specification.startsWith("unix:"))
+		return specification.length() > 5 ? new LocalProbeTransport(specification.mid(5), parent) : 0;
+	auto port_name = specification.startsWith("serial:") ? specification.mid(7) : specification;
+	return port_name.isEmpty() ? 0 : new SerialProbeTransport(port_name, parent);
+}
+
+bool SerialProbeTransport::open(void)
+{
+	if (!port.open(QSerialPort::ReadWrite))
+		return false;
+	if (!port.setDataTerminalReady(true))
+	{
+		port.close();
+		return false;
+	}
+	connect(& port, SIGNAL(error(QSerialPort::SerialPortError)), this, SLOT(portError(QSerialPort::SerialPortError)));
+	connectDevice();
+	return true;
+}
+
+bool TcpProbeTransport::open(void)
+{
+	socket.connectToHost(host_name, port_number);
+	if (!socket.waitForConnected(CONNECT_TIMEOUT_MS))
+	{
+		qDebug() << "error connecting to" << description() << socket.errorString();
+		socket.abort();
+		return false;
+	}
+	/* disable the nagle algorithm - probe requests are small, and latency sensitive */
+	socket.setSocketOption(QAbstractSocket::LowDelayOption, 1);
+	connect(& socket, SIGNAL(disconnected()), this, SIGNAL(connectionLost()));
+	connectDevice();
+	return true;
+}
+
+bool LocalProbeTransport::open(void)
+{
+	socket.connectToServer(server_name);
+	if (!socket.waitForConnected(CONNECT_TIMEOUT_MS))
+	{
+		qDebug() << "error connecting to" << description() << socket.errorString();
+		socket.abort();
+		return false;
+	}
+	connect(& socket, SIGNAL(disconnected()), this, SIGNAL(connectionLost()));
+	connectDevice();
+	return true;
+}
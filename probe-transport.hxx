@@ -0,0 +1,160 @@
+/*
+Copyright (c) 2019 stoyan shopov
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+#ifndef PROBETRANSPORT_HXX
+#define PROBETRANSPORT_HXX
+
+#include <QObject>
+#include <QIODevice>
+#include <QSerialPort>
+#include <QTcpSocket>
+#include <QLocalSocket>
+#include <QTimer>
+
+#include "target.hxx"
+
+/* Byte stream transport to a debug probe. Probe protocol code only deals with this class, and is
+ * thus not concerned with how the probe is actually reached - be it a serial port, a tcp connection
+ * (e.g., to a ser2net bridge, or to a network attached blackmagic), or a local (unix domain) socket.
+ *
+ * Writes are coalesced - data written is buffered until 'flush()' is called, or until the buffered
+ * data exceeds the write coalescing limit, so that, e.g., several pipelined request packets are
+ * sent with a single system call (and, for tcp transports, in a single segment).
+ *
+ * Reads are batched - when data arrives, the 'dataReceived()' signal is emitted after the read
+ * batching delay (if nonzero) expires, so that data arriving in bursts is processed at once; a read
+ * batching delay of zero delivers the data as soon as it arrives, for the lowest possible latency */
+class ProbeTransport : public QObject
+{
+	Q_OBJECT
+public:
+	/* Constructs a transport from a transport specification, which is one of:
+	 *	serial:port-name
+	 *	tcp:host-name:port-number
+	 *	unix:socket-path
+	 * A specification without a recognized prefix is taken to be a serial port name.
+	 * Returns 0 if the specification is invalid. The transport returned is not yet opened */
+	static ProbeTransport * create(const QString & specification, QObject * parent = 0);
+	virtual bool open(void) = 0;
+	virtual void close(void) { write_buffer.clear(); device()->close(); }
+	virtual QString description(void) = 0;
+	bool isOpen(void) { return device()->isOpen(); }
+
+	void setWriteCoalescingLimit(int limit) { write_coalescing_limit = limit; }
+	void setReadBatchingDelay(int milliseconds) { read_batching_timer.setInterval(milliseconds); }
+
+	void write(const QByteArray & data) { write_buffer += data; if (write_buffer.size() >= write_coalescing_limit) flush(); }
+	void flush(void) { if (write_buffer.isEmpty()) return; if (device()->write(write_buffer) != write_buffer.size()) qDebug() << "error writing to" << description(); write_buffer.clear(); }
+	QByteArray readAll(void) { return device()->readAll(); }
+	bool waitForReadyRead(int milliseconds) { return device()->waitForReadyRead(milliseconds); }
+	bool waitForBytesWritten(int milliseconds) { flush(); return device()->bytesToWrite() == 0 || device()->waitForBytesWritten(milliseconds); }
+	/* the time at which data, not yet read by 'readAll()', started arriving, as returned by 'Target::timestamp()' */
+	int64_t receiveTimestamp(void) { return receive_timestamp; }
+signals:
+	void dataReceived(void);
+	void connectionLost(void);
+protected:
+	ProbeTransport(QObject * parent, int write_coalescing_limit) : QObject(parent)
+	{
+		this->write_coalescing_limit = write_coalescing_limit;
+		read_batching_timer.setSingleShot(true);
+		read_batching_timer.setInterval(0);
+		connect(& read_batching_timer, SIGNAL(timeout()), this, SIGNAL(dataReceived()));
+	}
+	virtual QIODevice * device(void) = 0;
+	/* must be called by derived classes after opening the device */
+	void connectDevice(void) { connect(device(), SIGNAL(readyRead()), this, SLOT(deviceReadyRead())); }
+protected slots:
+	void deviceReadyRead(void)
+	{
+		if (read_batching_timer.isActive())
+			return;
+		receive_timestamp = Target::timestamp();
+		if (!read_batching_timer.interval())
+			emit dataReceived();
+		else
+			read_batching_timer.start();
+	}
+private:
+	QByteArray	write_buffer;
+	int		write_coalescing_limit;
+	QTimer		read_batching_timer;
+	int64_t		receive_timestamp = 0;
+};
+
+class SerialProbeTransport : public ProbeTransport
+{
+	Q_OBJECT
+	QSerialPort	port;
+	QIODevice * device(void) { return & port; }
+private slots:
+	void portError(QSerialPort::SerialPortError error) { if (error == QSerialPort::ResourceError) emit connectionLost(); }
+public:
+	enum
+	{
+		/* usb cdc-acm full speed bulk transfers are at most 64 bytes, but the usb stack takes care of splitting larger writes */
+		WRITE_COALESCING_LIMIT	=	4096,
+	};
+	SerialProbeTransport(const QString & port_name, QObject * parent = 0) : ProbeTransport(parent, WRITE_COALESCING_LIMIT), port(port_name) {}
+	bool open(void);
+	QString description(void) { return QString("serial port %1").arg(port.portName()); }
+	/* only applicable to serial transports, used by the blackstrike probe */
+	QSerialPort * serialPort(void) { return & port; }
+};
+
+class TcpProbeTransport : public ProbeTransport
+{
+	Q_OBJECT
+	QTcpSocket	socket;
+	QString		host_name;
+	quint16		port_number;
+	QIODevice * device(void) { return & socket; }
+public:
+	enum
+	{
+		CONNECT_TIMEOUT_MS	=	3000,
+		/* keep coalesced writes within a typical ethernet segment */
+		WRITE_COALESCING_LIMIT	=	1400,
+	};
+	TcpProbeTransport(const QString & host_name, quint16 port_number, QObject * parent = 0) : ProbeTransport(parent, WRITE_COALESCING_LIMIT)
+	{ this->host_name = host_name; this->port_number = port_number; }
+	bool open(void);
+	QString description(void) { return QString("tcp connection to %1:%2").arg(host_name).arg(port_number); }
+};
+
+class LocalProbeTransport : public ProbeTransport
+{
+	Q_OBJECT
+	QLocalSocket	socket;
+	QString		server_name;
+	QIODevice * device(void) { return & socket; }
+public:
+	enum
+	{
+		CONNECT_TIMEOUT_MS	=	3000,
+		WRITE_COALESCING_LIMIT	=	0x10000,
+	};
+	LocalProbeTransport(const QString & server_name, QObject * parent = 0) : ProbeTransport(parent, WRITE_COALESCING_LIMIT) { this->server_name = server_name; }
+	bool open(void);
+	QString description(void) { return QString("local socket %1").arg(server_name); }
+};
+
+#endif // PROBETRANSPORT_HXX
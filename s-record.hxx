@@ -22,35 +22,152 @@ THE SOFTWARE.
 #ifndef SRECORDMEMORYDATA_H
 #define SRECORDMEMORYDATA_H
 
-#include <QFile>
+#include <string.h>
+#include <ctype.h>
 #include <QFile>
 #include <QDebug>
+#include <QElapsedTimer>
 #include "memory.hxx"
 #include "util.hxx"
-#include <QRegExp>
 
 
+/* Loads Motorola S-record (S19, S28 and S37) files. The file is parsed in place, record checksums
+ * are validated, and contiguous data records are accumulated before being added to the memory contents */
 class SRecordMemoryData
 {
 public:
-	static bool loadFile(const QString & filename, Memory & memory)
+	static bool loadFile(const QString & filename, Memory & memory, QString * error_message = 0)
 	{
 		QFile f(filename);
-		QRegExp rx("S(.)(..)(........)(.+)(\\w\\w)");
 		if (!f.open(QFile::ReadOnly))
-			Util::panic();
-		while (!f.atEnd())
 		{
-			if (rx.indexIn(f.readLine()) != -1)
+			if (error_message)
+				* error_message = QString("cannot open file %1").arg(filename);
+			return false;
+		}
+		QByteArray contents;
+		const char * p = (const char *) f.map(0, f.size());
+		if (!p)
+		{
+			contents = f.readAll();
+			p = contents.constData();
+		}
+		return load(p, f.size(), memory, error_message);
+	}
+	static bool load(const char * s, qint64 size, Memory & memory, QString * error_message = 0)
+	{
+		const char * end = s + size, * line_end;
+		int line_number = 0;
+		uint32_t data_address = 0;
+		QByteArray data;
+		unsigned char record[256];
+
+		for (; s < end; s = line_end + 1)
+		{
+			line_number ++;
+			if (!(line_end = (const char *) memchr(s, '\n', end - s)))
+				line_end = end;
+			int length = line_end - s;
+			while (length && (s[length - 1] == '\r' || s[length - 1] == ' ' || s[length - 1] == '\t'))
+				length --;
+			if (!length)
+				continue;
+			if (length < 4 || s[0] != 'S' || !isdigit(s[1]))
+				return error(error_message, line_number, "malformed record");
+
+			int i, count = Util::hexByte(s + 2), sum = count;
+			if (count < 0 || length != 4 + 2 * count)
+				return error(error_message, line_number, "invalid record length");
+			for (i = 0; i < count; i ++)
+			{
+				int x = Util::hexByte(s + 4 + 2 * i);
+				if (x < 0)
+					return error(error_message, line_number, "invalid hexadecimal digit");
+				sum += (record[i] = x);
+			}
+			if ((sum & 0xff) != 0xff)
+				return error(error_message, line_number, "checksum mismatch");
+
+			int address_size;
+			switch (s[1])
 			{
-				if (rx.cap(1) != "3")
+				case '1': address_size = 2; break;
+				case '2': address_size = 3; break;
+				case '3': address_size = 4; break;
+				case '0': case '5': case '6': case '7': case '8': case '9':
+					/* header, record count and termination records - nothing to load */
 					continue;
-				memory.addRange(rx.cap(3).toUInt(0, 16), QByteArray::fromHex(rx.cap(4).toLocal8Bit()));
+				default:
+					return error(error_message, line_number, "unsupported record type");
+			}
+			if (count < address_size + 1)
+				return error(error_message, line_number, "record too short");
+			uint32_t address = 0;
+			for (i = 0; i < address_size; address = (address << 8) | record[i ++]);
+			if (address != data_address + data.size())
+			{
+				memory.addRange(data_address, data);
+				data.clear();
+				data_address = address;
 			}
+			data.append((const char *) record + address_size, count - address_size - 1);
 		}
-		memory.dump();
+		memory.addRange(data_address, data);
 		return true;
 	}
+	/* Generates S28 and S37 files for a multi-megabyte memory image, and times loading them */
+	static void benchmark(void)
+	{
+		enum
+		{
+			IMAGE_SIZE		= 4 * 1024 * 1024,
+			RECORD_DATA_SIZE	= 32,
+		};
+		const struct { const char * name; char type; int address_size; uint32_t address; } formats[] =
+		{
+			{ "S28", '2', 3, 0x100000, },
+			{ "S37", '3', 4, 0x08000000, },
+		};
+		QByteArray image(IMAGE_SIZE, 0);
+		int i, j;
+		for (i = 0; i < IMAGE_SIZE; i ++)
+			image[i] = (char) (i * 7 + (i >> 11));
+
+		for (const auto & format : formats)
+		{
+			QByteArray file = "S00F000068656C6C6F202020202000003C\r\n";
+			for (i = 0; i < IMAGE_SIZE; i += RECORD_DATA_SIZE)
+			{
+				QByteArray record(1, (char) (format.address_size + RECORD_DATA_SIZE + 1));
+				for (j = format.address_size - 1; j >= 0; j --)
+					record += (char) ((format.address + i) >> (8 * j));
+				record += image.mid(i, RECORD_DATA_SIZE);
+				int sum = 0;
+				for (j = 0; j < record.size(); sum += (uint8_t) record.at(j ++));
+				record += (char) ~ sum;
+				file += QByteArray("S") + format.type + record.toHex().toUpper() + "\r\n";
+			}
+			file += format.type == '2' ? "S804000000FB\r\n" : "S70500000000FA\r\n";
+
+			Memory memory;
+			QString error_message;
+			QElapsedTimer t;
+			t.start();
+			bool result = load(file.constData(), file.size(), memory, & error_message);
+			auto ns = t.nsecsElapsed();
+			qDebug() << "s-record loader benchmark:" << format.name << "file size" << file.size() << "bytes,"
+				 << (result ? "loaded" : "failed:") << error_message
+				 << (memory.data(format.address, IMAGE_SIZE) == image ? "data matching," : "DATA MISMATCH,")
+				 << (ns ? file.size() * 1000. / ns : 0.) << "MB/s";
+		}
+	}
+private:
+	static bool error(QString * error_message, int line_number, const char * reason)
+	{
+		if (error_message)
+			* error_message = QString("line %1: %2").arg(line_number).arg(reason);
+		return false;
+	}
 };
 
 #endif // SRECORDMEMORYDATA_H
@@ -0,0 +1,102 @@
+/*
+Copyright (c) 2019 stoyan shopov
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+#ifndef STATICOBJECTADDRESSINDEX_HXX
+#define STATICOBJECTADDRESSINDEX_HXX
+
+#include <QVector>
+#include <QSet>
+#include <QString>
+#include <stdint.h>
+#include <vector>
+#include <algorithm>
+
+#include "libtroll.hxx"
+#include "util.hxx"
+#include "elf-symbol-index.hxx"
+
+/* An index of the address ranges of the static storage duration data objects and functions in the target program,
+ * for answering the question 'which object, if any, contains this address' - e.g., for annotating pointer values
+ * as 'symbol+offset'. Data objects are taken from the debug information, with their sizes computed from their
+ * types; functions, and any data objects without debug information, are taken from the ELF symbol table */
+class StaticObjectAddressIndex
+{
+private:
+	enum
+	{
+		/* how many preceding entries to inspect when looking for an object containing an address,
+		 * to account for objects that are nested in, or overlap, other objects */
+		MAX_OVERLAPPING_OBJECTS		= 4,
+	};
+	struct object_range
+	{
+		uint32_t	address;
+		uint32_t	size;
+		QString		name;
+	};
+	/* sorted by address */
+	QVector<struct object_range> objects;
+public:
+	void build(DwarfData * dwdata, const std::vector<struct StaticObject> & data_objects, const ElfSymbolIndex & elf_symbols)
+	{
+		unsigned i;
+		QSet<uint32_t> data_object_addresses;
+
+		objects.clear();
+		objects.reserve(data_objects.size() + elf_symbols.symbolCount());
+		for (i = 0; i < data_objects.size(); i ++)
+		{
+			std::vector<struct DwarfTypeNode> type_cache;
+			dwdata->readType(data_objects.at(i).die_offset, type_cache);
+			int size = dwdata->sizeOf(type_cache, 1);
+			objects.push_back((struct object_range) { .address = data_objects.at(i).address, .size = (uint32_t) Util::max(size, 0),
+					.name = data_objects.at(i).name ? QString(data_objects.at(i).name) : QString(), });
+			data_object_addresses.insert(data_objects.at(i).address);
+		}
+		for (i = 0; i < (unsigned) elf_symbols.symbolCount(); i ++)
+		{
+			const ElfSymbolIndex::Symbol & s = elf_symbols.symbolAt(i);
+			/* data objects with debug information have already been added */
+			if (s.is_function || !data_object_addresses.contains(s.address))
+				objects.push_back((struct object_range) { .address = s.address, .size = s.size, .name = s.name, });
+		}
+		std::stable_sort(objects.begin(), objects.end(), [] (const struct object_range & a, const struct object_range & b) -> bool
+			{ return a.address < b.address || (a.address == b.address && a.size > b.size); });
+	}
+	/* Returns a 'symbol+offset' string for the address passed, or an empty string if no object contains the address */
+	QString describeAddress(uint32_t address) const
+	{
+		int i = std::upper_bound(objects.cbegin(), objects.cend(), address,
+			[] (uint32_t address, const struct object_range & object) -> bool { return address < object.address; }) - objects.cbegin();
+		int limit = Util::max(i - MAX_OVERLAPPING_OBJECTS, 0);
+		while (i -- > limit)
+		{
+			const struct object_range & x = objects.at(i);
+			if (address == x.address)
+				return x.name;
+			if (address - x.address < x.size)
+				return QString("%1+0x%2").arg(x.name).arg(address - x.address, 0, 16);
+		}
+		return QString();
+	}
+};
+
+#endif // STATICOBJECTADDRESSINDEX_HXX
@@ -20,43 +20,224 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
 THE SOFTWARE.
 */
 #include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QRegExp>
+#include <QStringList>
+#include <QDebug>
+#include <QMutexLocker>
 #include <QMessageBox>
+#include <algorithm>
 
 #include "target.hxx"
 #include "util.hxx"
 #include "target-corefile.hxx"
 
+QHash<QString, struct TargetCorefile::mapped_file> TargetCorefile::mapped_files;
+QMutex TargetCorefile::mapped_files_mutex;
+
+const char * TargetCorefile::mapFile(const QString & filename, qint64 & size)
+{
+	QFileInfo file_info(filename);
+	QString path = file_info.absoluteFilePath();
+	QMutexLocker locker(& mapped_files_mutex);
+	auto m = mapped_files.constFind(path);
+
+	if (m != mapped_files.cend() && m.value().size == file_info.size() && m.value().last_modified == file_info.lastModified())
+		return size = m.value().size, m.value().data;
+	QFile * f = new QFile(path);
+	const char * data;
+	if (!f->open(QFile::ReadOnly) || !(size = f->size()) || !(data = (const char *) f->map(0, size)))
+	{
+		delete f;
+		return 0;
+	}
+	mapped_files.insert(path, (struct mapped_file) { .file = f, .data = data, .size = size, .last_modified = file_info.lastModified(), });
+	return data;
+}
+
+bool TargetCorefile::addRegion(uint32_t address, const QString & filename, qint64 offset, qint64 size)
+{
+	qint64 file_size;
+	const char * data = mapFile(filename, file_size);
+
+	if (!data || offset < 0 || offset >= file_size)
+		return false;
+	if (size < 0 || offset + size > file_size)
+		size = file_size - offset;
+	if (address + (uint64_t) size > 0x100000000ULL)
+		return false;
+	memory_regions.push_back((struct memory_region) { .address = address, .size = (uint32_t) size, .data = data + offset, });
+	std::sort(memory_regions.begin(), memory_regions.end(), [] (const struct memory_region & a, const struct memory_region & b) -> bool
+		{ return a.address < b.address; });
+	return true;
+}
+
+bool TargetCorefile::loadElfCore(const QString & filename, QString & error_message)
+{
+	enum
+	{
+		ET_CORE		= 4,
+		PT_LOAD		= 1,
+		PT_NOTE		= 4,
+		NT_PRSTATUS	= 1,
+		/* offset of the 'pr_reg' field in the ARM 'elf_prstatus' structure */
+		PRSTATUS_PR_REG_OFFSET	= 72,
+		/* r0 - r15, and the program status register */
+		PRSTATUS_REGISTER_COUNT	= 17,
+		ELF_HEADER_SIZE		= 52,
+		PROGRAM_HEADER_SIZE	= 32,
+	};
+	qint64 file_size;
+	const char * elf = mapFile(filename, file_size);
+	auto word = [&] (qint64 offset) -> uint32_t { return * (const uint32_t *) (elf + offset); };
+	auto half = [&] (qint64 offset) -> uint16_t { return * (const uint16_t *) (elf + offset); };
+	int i;
+
+	if (!elf || file_size < ELF_HEADER_SIZE)
+		return error_message = "cannot read file " + filename, false;
+	if (elf[4] != /* ELFCLASS32 */ 1 || elf[5] != /* ELFDATA2LSB */ 1)
+		return error_message = "only 32 bit, little-endian ELF core files are supported", false;
+	if (half(16) != ET_CORE)
+		return error_message = filename + " is not an ELF core file", false;
+	uint32_t phoff = word(28);
+	int phentsize = half(42), phnum = half(44);
+	if (phentsize < PROGRAM_HEADER_SIZE || phoff + (qint64) phnum * phentsize > file_size)
+		return error_message = "invalid ELF program header table", false;
+
+	for (i = 0; i < phnum; i ++)
+	{
+		qint64 ph = phoff + (qint64) i * phentsize;
+		uint32_t type = word(ph), offset = word(ph + 4), vaddr = word(ph + 8), filesz = word(ph + 16);
+		if (type == PT_LOAD && filesz)
+		{
+			if (!addRegion(vaddr, filename, offset, filesz))
+				return error_message = QString("invalid PT_LOAD segment at address $%1").arg(vaddr, 8, 16, QChar('0')), false;
+		}
+		else if (type == PT_NOTE)
+		{
+			qint64 note = offset, end = (qint64) offset + filesz;
+			if (end > file_size)
+				return error_message = "invalid PT_NOTE segment", false;
+			while (note + 12 <= end)
+			{
+				uint32_t namesz = word(note), descsz = word(note + 4), note_type = word(note + 8);
+				qint64 desc = note + 12 + ((namesz + 3) & ~3);
+				if (desc + descsz > end)
+					break;
+				if (note_type == NT_PRSTATUS && descsz >= PRSTATUS_PR_REG_OFFSET + PRSTATUS_REGISTER_COUNT * sizeof(uint32_t)
+						&& register_file.isEmpty())
+					/* only use the registers of the first thread */
+					register_file = QByteArray(elf + desc + PRSTATUS_PR_REG_OFFSET, PRSTATUS_REGISTER_COUNT * sizeof(uint32_t));
+				note = desc + ((descsz + 3) & ~3);
+			}
+		}
+	}
+	if (memory_regions.isEmpty())
+		return error_message = "no memory contents found in ELF core file " + filename, false;
+	return true;
+}
+
+bool TargetCorefile::loadManifest(const QString & filename, QString & error_message)
+{
+	QFile f(filename);
+	QDir dir = QFileInfo(filename).absoluteDir();
+	int line_number = 0;
+
+	if (!f.open(QFile::ReadOnly))
+		return error_message = "cannot open file " + filename, false;
+	while (!f.atEnd())
+	{
+		line_number ++;
+		QString line = QString(f.readLine()).trimmed();
+		if (line.isEmpty() || line.startsWith('#'))
+			continue;
+		QStringList fields = line.split(QRegExp("\\s+"));
+		bool ok = true;
+		if (fields.at(0) == "memory" && fields.size() >= 3 && fields.size() <= 5)
+		{
+			uint32_t address = fields.at(1).toUInt(& ok, 0);
+			qint64 offset = 0, size = -1;
+			if (ok && fields.size() > 3)
+				offset = fields.at(3).toLongLong(& ok, 0);
+			if (ok && fields.size() > 4)
+				size = fields.at(4).toLongLong(& ok, 0);
+			if (ok && !addRegion(address, dir.absoluteFilePath(fields.at(2)), offset, size))
+				return error_message = QString("%1, line %2: cannot map memory region file %3").arg(filename).arg(line_number).arg(fields.at(2)), false;
+		}
+		else if (fields.at(0) == "registers" && fields.size() == 2)
+		{
+			QFile r(dir.absoluteFilePath(fields.at(1)));
+			if (!r.open(QFile::ReadOnly))
+				return error_message = QString("%1, line %2: cannot read register file %3").arg(filename).arg(line_number).arg(fields.at(1)), false;
+			register_file = r.readAll();
+		}
+		else
+			ok = false;
+		if (!ok)
+			return error_message = QString("%1, line %2: invalid manifest entry").arg(filename).arg(line_number), false;
+	}
+	if (memory_regions.isEmpty())
+		return error_message = "no memory regions described in manifest file " + filename, false;
+	return true;
+}
+
+TargetCorefile * TargetCorefile::load(const QString & filename, QString * error_message)
+{
+	QFile f(filename);
+	QString error;
+	TargetCorefile * target = new TargetCorefile();
+	bool result;
+
+	if (!f.open(QFile::ReadOnly))
+		result = false, error = "cannot open file " + filename;
+	else if (f.read(4) == "\x7f" "ELF")
+		result = target->loadElfCore(filename, error);
+	else
+		result = target->loadManifest(filename, error);
+	if (result)
+		return target;
+	delete target;
+	if (error_message)
+		* error_message = error;
+	return 0;
+}
+
 TargetCorefile::TargetCorefile(const QString & rom_filename, uint32_t rom_base_address, const QString & ram_filename, uint32_t ram_base_address, const QString register_filename)
 {
-	this->rom_base_address = rom_base_address;
-	this->ram_base_address = ram_base_address;
 	QFile f;
-	f.setFileName(rom_filename);
-	if (f.open(QFile::ReadOnly))
-		rom = f.readAll(), f.close();
-	f.setFileName(ram_filename);
-	if (f.open(QFile::ReadOnly))
-		ram = f.readAll(), f.close();
+	addRegion(rom_base_address, rom_filename);
+	addRegion(ram_base_address, ram_filename);
 	f.setFileName(register_filename);
 	if (f.open(QFile::ReadOnly))
 		register_file = f.readAll(), f.close();
 }
 
+int TargetCorefile::regionIndex(uint32_t address) const
+{
+	int i = std::upper_bound(memory_regions.cbegin(), memory_regions.cend(), address,
+		[] (uint32_t address, const struct memory_region & region) -> bool { return address < region.address; }) - memory_regions.cbegin() - 1;
+	if (i < 0 || address - memory_regions.at(i).address >= memory_regions.at(i).size)
+		return -1;
+	return i;
+}
+
 QByteArray TargetCorefile::readBytes(uint32_t address, int byte_count, bool is_failure_allowed)
 {
-	if (rom_base_address <= address && address < rom_base_address + rom.length() - byte_count + 1)
-	{
-		if (address - rom_base_address + byte_count >= rom.length())
-			goto failure;
-		return QByteArray(rom.data() + address - rom_base_address, byte_count);
-	}
-	if (ram_base_address <= address && address < ram_base_address + ram.length() - byte_count + 1)
+	int i = regionIndex(address);
+	if (i != -1 && byte_count >= 0)
 	{
-		if (address - ram_base_address + byte_count >= ram.length())
-			goto failure;
-		return QByteArray(ram.data() + address - ram_base_address, byte_count);
+		const struct memory_region & r = memory_regions.at(i);
+		uint32_t offset = address - r.address;
+		if (offset + (uint64_t) byte_count <= r.size)
+			return QByteArray::fromRawData(r.data + offset, byte_count);
+		/* the read spans more than one region - the regions must be contiguous */
+		QByteArray data(r.data + offset, r.size - offset);
+		while (data.size() < byte_count && ++ i < memory_regions.size() && memory_regions.at(i).address == address + data.size())
+			data.append(memory_regions.at(i).data, Util::min<qint64>(memory_regions.at(i).size, byte_count - data.size()));
+		if (data.size() == byte_count)
+			return data;
 	}
-failure:
 	if (is_failure_allowed)
 	{
 		qDebug() << QString("cannot read %1 bytes at address $%2 from target memory").arg(byte_count).arg(address, 8, 16, QChar('0'));
@@ -68,6 +249,8 @@ failure:
 	}
 	else
 	{
+		if (Util::isHeadless())
+			throw MEMORY_READ_ERROR;
 		QMessageBox::critical(0, "cannot read target memory", QString("cannot read $%1 bytes at address $%1 from target memory\n"
 		                                                              "the troll will now abort"
 		                                                              )
@@ -80,10 +263,12 @@ failure:
 
 uint32_t TargetCorefile::readWord(uint32_t address)
 {
-	if (rom_base_address <= address && address < rom_base_address + rom.length() - sizeof(uint32_t) + 1)
-		return * (uint32_t *) (rom.data() + address - rom_base_address);
-	if (ram_base_address <= address && address < ram_base_address + ram.length() - sizeof(uint32_t) + 1)
-		return * (uint32_t *) (ram.data() + address - ram_base_address);
+	int i = regionIndex(address);
+	if (i != -1 && address - memory_regions.at(i).address + sizeof(uint32_t) <= memory_regions.at(i).size)
+		return * (const uint32_t *) (memory_regions.at(i).data + address - memory_regions.at(i).address);
+	auto x = readBytes(address, sizeof(uint32_t), true);
+	if (x.size() == sizeof(uint32_t))
+		return * (const uint32_t *) x.constData();
 	throw MEMORY_READ_ERROR;
 	Util::panic();
 }
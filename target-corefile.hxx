@@ -23,16 +23,62 @@ THE SOFTWARE.
 #define TARGETCOREFILE_HXX
 
 #include <QString>
+#include <QVector>
+#include <QHash>
+#include <QFile>
+#include <QDateTime>
+#include <QMutex>
 #include "target.hxx"
 #include "util.hxx"
 
+/* A target, the state of which is read from a snapshot (a core file), instead of from a live target.
+ * Supported snapshot formats are:
+ *	- ELF core files - memory contents are taken from the PT_LOAD segments, and registers are taken from
+ *	  the NT_PRSTATUS note in the PT_NOTE segment
+ *	- manifest files - text files, describing a number of memory regions, and a register file; each line is
+ *	  one of:
+ *		memory <address> <filename> [<file offset> [<size>]]
+ *		registers <filename>
+ *	  empty lines, and lines starting with '#', are ignored; relative file names are relative to the
+ *	  directory of the manifest file
+ * Memory regions are memory mapped, and not read in memory, and memory reads from regions are zero-copy,
+ * so that large snapshots can be examined without loading them in memory */
 class TargetCorefile : public Target
 {
 private:
-	uint32_t rom_base_address, ram_base_address;
-	QByteArray rom, ram, register_file;
+	struct memory_region
+	{
+		uint32_t	address;
+		uint32_t	size;
+		const char	* data;
+	};
+	/* sorted by address */
+	QVector<struct memory_region> memory_regions;
+	QByteArray register_file;
+	/* Each file is mapped exactly once, and is never unmapped, because data returned by 'readBytes()' refers
+	 * to the mapped file contents, and such data may outlive the target object; mappings are shared between
+	 * target objects, and between the memory regions of a target object. A file is only mapped again if it
+	 * has been modified since it was mapped, e.g. when a new core dump is saved over an old one */
+	struct mapped_file
+	{
+		QFile		* file;
+		const char	* data;
+		qint64		size;
+		QDateTime	last_modified;
+	};
+	static QHash<QString, struct mapped_file> mapped_files;
+	/* core dumps may be loaded concurrently, e.g. by the batch crash triage */
+	static QMutex mapped_files_mutex;
+	static const char * mapFile(const QString & filename, qint64 & size);
+	bool addRegion(uint32_t address, const QString & filename, qint64 offset = 0, qint64 size = -1);
+	bool loadElfCore(const QString & filename, QString & error_message);
+	bool loadManifest(const QString & filename, QString & error_message);
+	int regionIndex(uint32_t address) const;
+	TargetCorefile(void) {}
 public:
 	TargetCorefile(const QString & rom_filename, uint32_t rom_base_address, const QString & ram_filename, uint32_t ram_base_address, const QString register_filename);
+	/* Loads an ELF core file, or a manifest file; returns null on failure */
+	static TargetCorefile * load(const QString & filename, QString * error_message = 0);
 	virtual QByteArray interrogate(const QByteArray & query, bool * isOk = 0) { Util::panic(); }
 	bool reset(void) { Util::panic(); }
 	QByteArray readBytes(uint32_t address, int byte_count, bool is_failure_allowed = false);
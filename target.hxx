@@ -26,7 +26,10 @@ THE SOFTWARE.
 #include <QObject>
 #include <QDebug>
 #include <QXmlStreamReader>
+#include <QVector>
+#include <QPair>
 #include <list>
+#include <chrono>
 
 #include "util.hxx"
 
@@ -40,6 +43,14 @@ enum TARGET_HALT_REASON
 	GENERIC_HALT_CONDITION,
 };
 
+enum FLASH_PROGRAMMING_PHASE
+{
+	FLASH_COMPARE		= 0,
+	FLASH_ERASE,
+	FLASH_WRITE,
+	FLASH_VERIFY,
+};
+
 enum TARGET_ERROR_ENUM
 {
 	INVALID		= 0,
@@ -52,7 +63,11 @@ class Target : public QObject
 signals:
 	void targetHalted(enum TARGET_HALT_REASON reason);
 	void targetRunning(void);
+	/* flash programming progress, emitted repeatedly while synchronizing the target flash contents */
+	void flashProgress(enum FLASH_PROGRAMMING_PHASE phase, unsigned bytes_done, unsigned bytes_total, unsigned bytes_per_second);
 public:
+	void reportFlashProgress(enum FLASH_PROGRAMMING_PHASE phase, unsigned bytes_done, unsigned bytes_total, unsigned elapsed_milliseconds)
+	{ emit flashProgress(phase, bytes_done, bytes_total, elapsed_milliseconds ? (uint64_t) bytes_done * 1000 / elapsed_milliseconds : 0); }
 	struct ram_area
 	{
 		uint32_t	start;
@@ -64,9 +79,27 @@ public:
 		uint32_t	length;
 		unsigned	blocksize;
 	};
+	/* Monotonic timestamp, in nanoseconds; used for measuring the latency of target halt notifications */
+	static int64_t timestamp(void) { return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count(); }
+	/* Returns the timestamp at which the last halt of the target was detected by the target
+	 * controller (e.g., the time at which a stop reply packet was received from a debug probe),
+	 * or 0, if not known */
+	int64_t haltTimestamp(void) { return halt_timestamp; }
 	virtual uint32_t readWord(uint32_t address) = 0;
 	virtual bool reset(void) = 0;
 	virtual QByteArray readBytes(uint32_t address, int byte_count, bool is_failure_allowed = false) = 0;
+	/* Vectored (scatter-gather) memory read - reads all of the memory ranges passed, and returns
+	 * their contents in the same order as in the 'ranges' vector. Ranges that cannot be read
+	 * are returned as empty byte arrays. This default implementation just reads the ranges one
+	 * by one, targets which can do better (e.g., by coalescing nearby ranges, and by pipelining
+	 * requests) should override it */
+	virtual QVector<QByteArray> readRanges(const QVector<QPair<uint32_t /* address */, int /* byte count */> > & ranges)
+	{
+		QVector<QByteArray> data;
+		for (const auto & range : ranges)
+			data.push_back(readBytes(range.first, range.second, true));
+		return data;
+	}
 	virtual uint32_t readRawUncachedRegister(uint32_t register_number) = 0;
 	virtual bool breakpointSet(uint32_t address, int length) = 0;
 	virtual bool breakpointClear(uint32_t address, int length) = 0;
@@ -77,6 +110,42 @@ public:
 	virtual uint32_t haltReason(void) = 0;
 	virtual QByteArray memoryMap(void) = 0;
 	virtual bool syncFlash(const Memory & memory_contents) = 0;
+	/* Computes the crc32 (as computed by class 'Crc32') of each of the target memory ranges passed,
+	 * on the target side, without reading target memory. Returns false if this is not supported by
+	 * the target, or if computing the checksums fails */
+	virtual bool memoryCrcs(const QVector<QPair<uint32_t, int> > & ranges, QVector<uint32_t> & crcs) { return false; }
+	/* Immutable memory policy - target memory reads that fall entirely inside flash memory
+	 * areas, which have been verified to match the memory image loaded from the target
+	 * executable, are answered from the image, and do not cost any communication with the target.
+	 * Immutable memory areas must only be added after the target flash contents have been
+	 * successfully verified, and are discarded whenever the target flash is about to be modified */
+	void setImmutableMemoryPolicy(bool is_enabled, int spot_check_interval = 0)
+	{
+		is_immutable_memory_policy_enabled = is_enabled;
+		immutable_memory_spot_check_interval = spot_check_interval;
+		immutable_memory_read_count = 0;
+		if (!is_enabled)
+			clearImmutableMemoryAreas();
+	}
+	void clearImmutableMemoryAreas(void) { immutable_memory_areas.clear(); }
+	/* only the parts of the memory range passed that reside in flash memory are considered immutable */
+	void addImmutableMemoryArea(uint32_t address, const QByteArray & data)
+	{
+		int i;
+		if (!is_immutable_memory_policy_enabled)
+			return;
+		for (i = 0; i < flash_areas.size(); i ++)
+		{
+			uint64_t start = Util::max((uint64_t) address, (uint64_t) flash_areas[i].start);
+			uint64_t end = Util::min((uint64_t) address + data.size(), (uint64_t) flash_areas[i].start + flash_areas[i].length);
+			if (start < end)
+				immutable_memory_areas.push_back((struct immutable_memory_area)
+					{ .start = (uint32_t) start, .data = data.mid(start - address, end - start), });
+		}
+	}
+	/* defined in file 'memory.hxx' */
+	void enableImmutableMemoryAreas(const Memory & memory_contents);
+	bool hasImmutableMemoryAreas(void) { return !immutable_memory_areas.empty(); }
 	void parseMemoryAreas(const QString & xml_memory_description)
 	{
 		uint32_t start, length;
@@ -124,6 +193,29 @@ public:
 			qDebug() << flash_areas[i].start << flash_areas[i].length;
 		std::sort(flash_areas.begin(), flash_areas.end(), compare_memory_areas);
 	}
+	/* Returns the flash erase blocks (start address and size pairs) that the memory range passed overlaps, in
+	 * ascending address order; if the memory range passed does not fit entirely in flash memory, an empty vector is returned */
+	std::vector<std::pair<uint32_t, uint32_t> > flashBlocksForRange(uint32_t address, uint32_t length)
+	{
+		int i;
+		std::vector<std::pair<uint32_t, uint32_t> > blocks;
+		uint64_t start = address, end = (uint64_t) address + length;
+		for (i = 0; start < end && i < flash_areas.size(); i ++)
+		{
+			uint64_t area_end = (uint64_t) flash_areas[i].start + flash_areas[i].length;
+			if (flash_areas[i].start <= start && start < area_end)
+			{
+				if (!flash_areas[i].blocksize)
+					break;
+				start -= (start - flash_areas[i].start) % flash_areas[i].blocksize;
+				for (; start < end && start < area_end; start += flash_areas[i].blocksize)
+					blocks.push_back(std::pair<uint32_t, uint32_t>(start, flash_areas[i].blocksize));
+			}
+		}
+		if (start < end)
+			blocks.clear();
+		return blocks;
+	}
 	/* if the memory range passed does not fit entirely in flash memory, an empty vector is returned */
 	std::vector<std::pair<uint32_t /* start address in flash */, uint32_t /* length of flash area */> > flashAreasForRange(uint32_t address, uint32_t length)
 	{
@@ -147,9 +239,78 @@ public:
 		return ranges;
 	}
 protected:
+	/* Sorts, and merges memory ranges that are at most 'max_gap' bytes apart. For each of the
+	 * merged spans returned, the indices of the ranges it covers are stored in 'span_ranges' */
+	static QVector<QPair<uint32_t, int> > coalesceRanges(const QVector<QPair<uint32_t, int> > & ranges, int max_gap, QVector<QVector<int> > & span_ranges)
+	{
+		QVector<int> order(ranges.size());
+		QVector<QPair<uint32_t, int> > spans;
+		int i;
+		span_ranges.clear();
+		for (i = 0; i < order.size(); i ++)
+			order[i] = i;
+		std::sort(order.begin(), order.end(), [& ranges] (int a, int b) -> bool { return ranges[a].first < ranges[b].first; });
+		for (i = 0; i < order.size(); i ++)
+		{
+			auto & r = ranges[order[i]];
+			if (r.second <= 0)
+				continue;
+			if (!spans.isEmpty() && (uint64_t) r.first <= (uint64_t) spans.last().first + spans.last().second + max_gap)
+			{
+				uint64_t end = Util::max((uint64_t) spans.last().first + spans.last().second, (uint64_t) r.first + r.second);
+				spans.last().second = end - spans.last().first;
+				span_ranges.last().push_back(order[i]);
+			}
+			else
+			{
+				spans.push_back(r);
+				span_ranges.push_back(QVector<int>() << order[i]);
+			}
+		}
+		return spans;
+	}
 	std::vector<struct ram_area> ram_areas;
 	std::vector<struct flash_area> flash_areas;
+	int64_t halt_timestamp = 0;
+	/* if the memory range passed resides entirely in an immutable memory area, returns
+	 * true, and the memory contents for the range in 'data'; otherwise, returns false */
+	bool immutableMemoryData(uint32_t address, int byte_count, QByteArray & data)
+	{
+		int i;
+		for (i = 0; i < immutable_memory_areas.size(); i ++)
+			if (immutable_memory_areas[i].start <= address
+				&& (uint64_t) address + byte_count <= (uint64_t) immutable_memory_areas[i].start + immutable_memory_areas[i].data.size())
+			{
+				data = immutable_memory_areas[i].data.mid(address - immutable_memory_areas[i].start, byte_count);
+				return true;
+			}
+		return false;
+	}
+	/* when spot checking is enabled, every n-th read of immutable memory is also performed
+	 * on the target, and the result is compared to the memory image contents */
+	bool isImmutableMemorySpotCheckDue(void)
+	{
+		return immutable_memory_spot_check_interval > 0
+			&& !(++ immutable_memory_read_count % immutable_memory_spot_check_interval);
+	}
+	void verifyImmutableMemorySpotCheck(uint32_t address, const QByteArray & image_data, const QByteArray & target_data)
+	{
+		if (image_data == target_data)
+			return;
+		qDebug() << "immutable memory spot check failed at address" << QString("$%1").arg(address, 8, 16, QChar('0'))
+			 << "- target memory contents do not match the memory image, no longer serving reads from the memory image";
+		clearImmutableMemoryAreas();
+	}
 private:
+	struct immutable_memory_area
+	{
+		uint32_t	start;
+		QByteArray	data;
+	};
+	std::vector<struct immutable_memory_area> immutable_memory_areas;
+	bool is_immutable_memory_policy_enabled = true;
+	int immutable_memory_spot_check_interval = 0;
+	unsigned immutable_memory_read_count = 0;
 	static bool compare_memory_areas(const struct flash_area & first, const struct flash_area & second) { return first.start < second.start; }
 };
 
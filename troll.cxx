@@ -153,6 +153,12 @@ QByteArray data;
 					n->setText(2, QString("%1 bit").arg(node.bitsize) + ((node.bitsize != 1) ? "s":""));
 				}
 				n->setText(1, node.is_pointer ? QString("$%1").arg(x, 8, 16, QChar('0')) : numeric_prefix + QString("%1").arg(x, 0, numeric_base));
+				if (node.is_pointer && x)
+				{
+					QString symbol = static_object_index.describeAddress(x);
+					if (!symbol.isEmpty())
+						n->setText(1, n->text(1) + " <" + symbol + ">");
+				}
 				switch (node.base_type_encoding)
 				{
 				case DW_ATE_float:
@@ -244,28 +250,19 @@ void MainWindow::colorizeSourceCodeView(void)
 #if 1
 QVector<int> enabled_breakpoint_positions, disabled_breakpoint_positions;
 QTextBlockFormat f;
-int i, x;
+int i;
 QList<QTextEdit::ExtraSelection> selections;
 QTextEdit::ExtraSelection sel;
 QTextCharFormat cf;
 
 	ui->plainTextEdit->setExtraSelections(selections);
-	QSet<struct BreakpointCache::SourceCodeBreakpoint>::const_iterator sset = breakpoints.enabledSourceCodeBreakpoints.constBegin();
-	while (sset != breakpoints.enabledSourceCodeBreakpoints.constEnd())
-	{
-		if ((x = (* sset).breakpointedLineNumberForSourceCode(current_source_view.filename, current_source_view.directory, current_source_view.compilation_directory)) != -1)
-			if (src.line_positions_in_document.contains(x))
-				enabled_breakpoint_positions << src.line_positions_in_document[x];
-		sset ++;
-	}
-	sset = breakpoints.disabledSourceCodeBreakpoints.constBegin();
-	while (sset != breakpoints.disabledSourceCodeBreakpoints.constEnd())
-	{
-		if ((x = (* sset).breakpointedLineNumberForSourceCode(current_source_view.filename, current_source_view.directory, current_source_view.compilation_directory)) != -1)
-			if (src.line_positions_in_document.contains(x))
-				disabled_breakpoint_positions << src.line_positions_in_document[x];
-		sset ++;
-	}
+	int source_file_key = BreakpointCache::sourceFileKey(current_source_view.filename, current_source_view.directory, current_source_view.compilation_directory);
+	for (auto line : breakpoints.enabledBreakpointLinesForSourceFile(source_file_key))
+		if (src.line_positions_in_document.contains(line))
+			enabled_breakpoint_positions << src.line_positions_in_document[line];
+	for (auto line : breakpoints.disabledBreakpointLinesForSourceFile(source_file_key))
+		if (src.line_positions_in_document.contains(line))
+			disabled_breakpoint_positions << src.line_positions_in_document[line];
 	QSet<uint32_t>::const_iterator bset = breakpoints.enabledMachineAddressBreakpoints.constBegin();
 	while (bset != breakpoints.enabledMachineAddressBreakpoints.constEnd())
 	{
@@ -385,6 +382,7 @@ void MainWindow::showDisassembly()
 void MainWindow::attachBlackmagicProbe(Target *blackmagic)
 {
 	delete target;
+	breakpoints.forgetInstalledBreakpoints();
 	cortexm0->setTargetController(target = blackmagic);
 	connect(target, SIGNAL(targetHalted(TARGET_HALT_REASON)), this, SLOT(targetHalted(TARGET_HALT_REASON)));
 	connect(target, SIGNAL(targetRunning()), this, SLOT(targetRunning()));
@@ -393,12 +391,31 @@ void MainWindow::attachBlackmagicProbe(Target *blackmagic)
 	
 }
 
+/* Creates a target from the core file configured in the settings file - which may be an ELF core file, or a
+ * snapshot manifest file - or, if none is configured, from the legacy 'flash.bin', 'ram.bin' and 'registers.bin' files */
+Target * MainWindow::createCorefileTarget(void)
+{
+QSettings s("troll.rc", QSettings::IniFormat);
+QString core_filename = s.value("core-file").toString(), error_message;
+
+	if (!core_filename.isEmpty())
+	{
+		TargetCorefile * t = TargetCorefile::load(core_filename, & error_message);
+		if (t)
+			return t;
+		QMessageBox::warning(0, "error loading core file", "error loading core file " + core_filename + ":\n" + error_message);
+	}
+	return new TargetCorefile("flash.bin", 0x08000000, "ram.bin", 0x20000000, "registers.bin");
+}
+
 void MainWindow::detachBlackmagicProbe()
 {
 	polishing_timer.stop();
-	blackstrike_port.close();
-	delete target;
-	target = new TargetCorefile("flash.bin", 0x08000000, "ram.bin", 0x20000000, "registers.bin");
+	breakpoints.forgetInstalledBreakpoints();
+	/* this may be called from a handler of a signal of the target, so do not delete the target right away */
+	target->disconnect(this);
+	target->deleteLater();
+	target = createCorefileTarget();
 	cortexm0->setTargetController(target);
 	targetDisconnected();
 	execution_state = INVALID_EXECUTION_STATE;
@@ -528,6 +545,102 @@ void MainWindow::navigateToSymbolAtCursor()
 	w->selectRow(x.at(0)->row());
 }
 
+/* Returns the interleaved source code and disassembly view for a source code file, building it if it is not cached, or
+ * if the source code file has changed since the view was built; returns null if the source code file cannot be read */
+MainWindow::InterleavedSourceView * MainWindow::interleavedSourceView(const QString & canonical_filename, const QString & source_filename)
+{
+QFile source_file(canonical_filename);
+QTime x;
+bool is_disassembly_shown = ui->actionShow_disassembly_address_ranges->isChecked();
+QDateTime modification_time = QFileInfo(canonical_filename).lastModified();
+std::vector<struct DebugLine::lineAddress> line_addresses;
+std::map<uint32_t, struct DebugLine::lineAddress *> line_indices;
+int i;
+
+	current_interleaved_source_view_key = qMakePair(canonical_filename, is_disassembly_shown);
+	auto view = interleaved_source_views.find(current_interleaved_source_view_key);
+	if (view != interleaved_source_views.end() && view->source_file_modification_time == modification_time)
+		return & view.value();
+	if (!source_file.open(QFile::ReadOnly))
+		return 0;
+	InterleavedSourceView & v = interleaved_source_views[current_interleaved_source_view_key] = InterleavedSourceView();
+	v.source_file_modification_time = modification_time;
+	QString & t = v.text;
+
+	x.start();
+	dwdata->addressesForFile(source_filename.toLocal8Bit().constData(), line_addresses);
+	if (/* this is not exact, which it needs not be */ x.elapsed() > profiling.max_addresses_for_file_retrieval_time)
+		profiling.max_addresses_for_file_retrieval_time = x.elapsed();
+	qDebug() << "addresses for file retrieved in " << x.elapsed() << "milliseconds";
+	qDebug() << "addresses for file count: " << line_addresses.size();
+
+	for (i = line_addresses.size() - 1; i >= 0; i --)
+	{
+		line_addresses.at(i).next = line_indices[line_addresses.at(i).line];
+		line_indices[line_addresses.at(i).line] = & line_addresses.at(i);
+	}
+
+	/* walk the source code lines and the line table rows for each line together, in a single pass */
+	i = 1;
+	while (!source_file.atEnd())
+	{
+		struct DebugLine::lineAddress * dis;
+		v.line_positions_in_document[i] = t.length();
+		t += QString("%2 %1|").arg(line_indices[i] ? '*' : ' ')
+				.arg(i, 0, 10, QChar(' ')) + source_file.readLine().replace('\t', "        ").replace('\r', "");
+		if (is_disassembly_shown)
+		{
+			dis = line_indices[i];
+			while (dis)
+			{
+				auto x = disassembly->disassemblyForRange(dis->address, dis->address_span);
+				int j;
+				for (j = 0; j < x.size(); j ++)
+				{
+					v.address_positions_in_document.insert(x.at(j).first, t.length());
+					t += QString(x.at(j).second).replace('\r', "") + "\n";
+				}
+				/* Merge successive disassembly ranges */
+				if (dis->next && dis->next->address != dis->address_span)
+					t += "...\n";
+				dis = dis->next;
+			}
+		}
+		i ++;
+	}
+
+#if 1
+	QProcess highlighter;
+	QFile outfile("C:/src/build-troll-Desktop_Qt_5_12_0_MinGW_64_bit-Debug/highlighted.html");
+
+	highlighter.start("C:/src/build-troll-Desktop_Qt_5_12_0_MinGW_64_bit-Debug/highlight/highlight.exe",
+			QStringList() << "-o" << outfile.fileName() << "--syntax=c");
+	highlighter.waitForStarted();
+	highlighter.write(t.toLocal8Bit());
+	highlighter.closeWriteChannel();
+	highlighter.waitForFinished();
+	if (highlighter.error() == QProcess::UnknownError && highlighter.exitStatus() == QProcess::NormalExit && highlighter.exitCode() == 0)
+	{
+		outfile.open(QFile::ReadOnly);
+		t = outfile.readAll();
+		v.is_html = true;
+	}
+#endif
+	return & v;
+}
+
+/* Returns the addresses suitable for placing breakpoints at a line of the currently displayed source code file */
+QVector<uint32_t> MainWindow::breakpointAddressesForLine(int line_number)
+{
+	auto view = interleaved_source_views.find(current_interleaved_source_view_key);
+	if (view == interleaved_source_views.end())
+		return QVector<uint32_t>::fromStdVector(dwdata->filteredAddressesForFileAndLineNumber(current_source_view.filename.toLocal8Bit().constData(), line_number));
+	if (!view->breakpoint_addresses_for_line.contains(line_number))
+		view->breakpoint_addresses_for_line[line_number] =
+			QVector<uint32_t>::fromStdVector(dwdata->filteredAddressesForFileAndLineNumber(current_source_view.filename.toLocal8Bit().constData(), line_number));
+	return view->breakpoint_addresses_for_line.value(line_number);
+}
+
 void MainWindow::displaySourceCodeFile(QString source_filename, QString directory_name, QString compilation_directory, int highlighted_line, uint32_t address)
 {
 	setWindowTitle(QString("troll debugger    File: [%1]").arg(source_filename));
@@ -545,15 +658,11 @@ void MainWindow::displaySourceCodeFile(QString source_filename, QString director
 
 QTime stime;
 stime.start();
-QFile source_file;
-QString t;
 QTextBlockFormat f;
 QTextCharFormat cf;
 QTime x;
-int i, cursor_position_for_line(0);
+int cursor_position_for_line(0);
 QFileInfo finfo(directory_name + "/" + adjusted_filename);
-std::vector<struct DebugLine::lineAddress> line_addresses;
-std::map<uint32_t, struct DebugLine::lineAddress *> line_indices;
 
 	src.address_positions_in_document.clear();
 	src.line_positions_in_document.clear();
@@ -565,86 +674,23 @@ std::map<uint32_t, struct DebugLine::lineAddress *> line_indices;
 	if (!finfo.exists())
 		finfo.setFile(adjusted_filename);
 	ui->plainTextEdit->clear();
-	source_file.setFileName(finfo.canonicalFilePath());
-	
 	x.start();
-	//dwdata->addressRangesForFile(source_filename.toLocal8Bit().constData(), line_addresses);
-	dwdata->addressesForFile(source_filename.toLocal8Bit().constData(), line_addresses);
-	if (/* this is not exact, which it needs not be */ x.elapsed() > profiling.max_addresses_for_file_retrieval_time)
-		profiling.max_addresses_for_file_retrieval_time = x.elapsed();
-	qDebug() << "addresses for file retrieved in " << x.elapsed() << "milliseconds";
-	qDebug() << "addresses for file count: " << line_addresses.size();
-	x.restart();
-	
-	for (i = line_addresses.size() - 1; i >= 0; i --)
-	{
-		line_addresses.at(i).next = line_indices[line_addresses.at(i).line];
-		line_indices[line_addresses.at(i).line] = & line_addresses.at(i);
-	}
-
-	if (source_file.open(QFile::ReadOnly))
+	auto view = interleavedSourceView(finfo.canonicalFilePath(), source_filename);
+	if (!view)
 	{
-		int i(1);
-		struct DebugLine::lineAddress * dis;
-		while (!source_file.atEnd())
-		{
-			src.line_positions_in_document[i] = t.length();
-			if (i == highlighted_line)
-				cursor_position_for_line = t.length();
-			t += QString("%2 %1|").arg(line_indices[i] ? '*' : ' ')
-					.arg(i, 0, 10, QChar(' ')) + source_file.readLine().replace('\t', "        ").replace('\r', "");
-			if (ui->actionShow_disassembly_address_ranges->isChecked())
-			{
-				if (0 && address == -1)
-					Util::panic();
-				dis = line_indices[i];
-				while (dis)
-				{
-					//t += QString("$%1 - $%2\n").arg(dis->address, 0, 16).arg(dis->address_span, 0, 16), dis = dis->next;
-					//t += QString("$%1 - $%2\n").arg(dis->address, 0, 16).arg(dis->address_span, 0, 16);
-					auto x = disassembly->disassemblyForRange(dis->address, dis->address_span);
-					int i;
-					for (i = 0; i < x.size(); i ++)
-					{
-						src.address_positions_in_document.insert(x.at(i).first, t.length());
-						if (address == x.at(i).first)
-							cursor_position_for_line = t.length();
-						t += QString(x.at(i).second).replace('\r', "") + "\n";
-					}
-					/* Merge successive disassembly ranges */
-					if (dis->next && dis->next->address != dis->address_span)
-						t += "...\n";
-					dis = dis->next;
-				}
-			}
-			i ++;
-		}
-
-#if 1
-		QProcess highlighter;
-		QFile outfile("C:/src/build-troll-Desktop_Qt_5_12_0_MinGW_64_bit-Debug/highlighted.html");
-
-		highlighter.start("C:/src/build-troll-Desktop_Qt_5_12_0_MinGW_64_bit-Debug/highlight/highlight.exe",
-				QStringList() << "-o" << outfile.fileName() << "--syntax=c");
-		highlighter.waitForStarted();
-		highlighter.write(t.toLocal8Bit());
-		highlighter.closeWriteChannel();
-		highlighter.waitForFinished();
-		if (highlighter.error() == QProcess::UnknownError && highlighter.exitStatus() == QProcess::NormalExit && highlighter.exitCode() == 0)
-		{
-			outfile.open(QFile::ReadOnly);
-			ui->plainTextEdit->appendHtml(outfile.readAll());
-		}
-		else
-#endif
-			ui->plainTextEdit->appendPlainText(t);
-	}
-	else
-	{
-		statusBar()->showMessage(QString("cannot open source code file ") + source_file.fileName());
+		statusBar()->showMessage(QString("cannot open source code file ") + finfo.canonicalFilePath());
 		showDisassembly();
 		return;
 	}
+	src.address_positions_in_document = view->address_positions_in_document;
+	src.line_positions_in_document = view->line_positions_in_document;
+	if (view->is_html)
+		ui->plainTextEdit->appendHtml(view->text);
+	else
+		ui->plainTextEdit->appendPlainText(view->text);
+	cursor_position_for_line = src.line_positions_in_document.value(highlighted_line, 0);
+	if (ui->actionShow_disassembly_address_ranges->isChecked() && src.address_positions_in_document.contains(address))
+		cursor_position_for_line = src.address_positions_in_document.value(address);
 
 	QTextCursor c(ui->plainTextEdit->textCursor());
 	c.movePosition(QTextCursor::Start);
@@ -706,7 +752,10 @@ void MainWindow::backtrace()
 		ui->tableWidgetBacktrace->setItem(row, 0, new QTableWidgetItem(QString("$%1").arg(cortexm0->programCounter(), 8, 16, QChar('0'))));
 		ui->tableWidgetBacktrace->setVerticalHeaderItem(row, new QTableWidgetItem(QString("%1").arg(register_cache.frameCount())));
 		ui->tableWidgetBacktrace->verticalHeaderItem(row)->setData(Qt::UserRole, register_cache.frameCount() - 1);
-		ui->tableWidgetBacktrace->setItem(row, 1, new QTableWidgetItem(QString(dwdata->nameOfDie(subprogram))));
+		QString subprogram_name(dwdata->nameOfDie(subprogram));
+		if (subprogram_name.isEmpty())
+			subprogram_name = elf_symbols.describeAddress(cortexm0->programCounter());
+		ui->tableWidgetBacktrace->setItem(row, 1, new QTableWidgetItem(subprogram_name));
 		ui->tableWidgetBacktrace->setItem(row, 2, new QTableWidgetItem(QString::fromStdString(x.file_name)));
 		ui->tableWidgetBacktrace->setItem(row, 3, new QTableWidgetItem(QString("%1").arg(x.line)));
 		ui->tableWidgetBacktrace->setItem(row, 4, new QTableWidgetItem(x.directory_name));
@@ -755,7 +804,20 @@ void MainWindow::backtrace()
 		ui->tableWidgetBacktrace->setItem(row - 1, 8, new QTableWidgetItem("n/a"));
 	}
 	else
+	{
+		/* no debug information for the program counter - at least show the ELF symbol for it, if available */
+		QString symbol = elf_symbols.describeAddress(cortexm0->programCounter());
+		if (!symbol.isEmpty())
+		{
+			ui->tableWidgetBacktrace->insertRow(0);
+			ui->tableWidgetBacktrace->setItem(0, 0, new QTableWidgetItem(QString("$%1").arg(cortexm0->programCounter(), 8, 16, QChar('0'))));
+			ui->tableWidgetBacktrace->setItem(0, 1, new QTableWidgetItem(symbol + " (no debug information)"));
+			ui->tableWidgetBacktrace->setVerticalHeaderItem(0, new QTableWidgetItem("0"));
+			ui->tableWidgetBacktrace->verticalHeaderItem(0)->setData(Qt::UserRole, 0);
+			ui->tableWidgetBacktrace->resizeColumnsToContents();
+		}
 		register_cache.setActiveFrame(0), updateRegisterView(), showDisassembly();
+	}
 	if (/* this is not exact, which it needs not be */ t.elapsed() > profiling.max_backtrace_generation_time)
 		profiling.max_backtrace_generation_time = t.elapsed();
 }
@@ -795,31 +857,32 @@ int i;
 	return true;
 }
 
-bool MainWindow::loadSRecordFile(void)
+/* Loads the target memory contents from a memory image file, instead of from the ELF file segments. The
+ * image format is selected by the file name extension; raw binary images are placed at the base address passed */
+bool MainWindow::loadMemoryImageFile(const QString & filename, uint32_t base_address)
 {
-QProcess objcopy;
-QString outfile = QFileInfo(elf_filename).fileName();
+QString suffix = QFileInfo(filename).suffix().toLower(), error_message;
+QTime t;
+bool result;
 
-	if (!TEST_DRIVE_MODE)
-	{
-		objcopy.start("arm-none-eabi-objcopy", QStringList() << "-O" << "srec" << elf_filename << outfile + ".srec");
-		objcopy.waitForFinished();
-		if (objcopy.error() != QProcess::UnknownError || objcopy.exitCode() || objcopy.exitStatus() != QProcess::NormalExit)
-		{
-			QMessageBox::critical(0, "error retrieving target memory areas",
-			                      "error running the 'arm-none-eabi-objcopy' utility in order to retrieve\n"
-			                      "target memory area contents!\n\n"
-			                      "please, make sure that the 'arm-none-eabi-objcopy' utility is accessible\n"
-			                      "in your path environment, and that the file you have specified\n"
-			                      "is indeed an ELF file!\n\n"
-			                      "target flash programming and verification will be unavailable in this session"
-			                      );
-			return false;
-		}
-		return SRecordMemoryData::loadFile(outfile + ".srec", target_memory_contents);
-	}
+	t.start();
+	if (suffix == "srec" || suffix == "s19" || suffix == "s28" || suffix == "s37" || suffix == "mot")
+		result = SRecordMemoryData::loadFile(filename, target_memory_contents, & error_message);
+	else if (suffix == "hex" || suffix == "ihex")
+		result = IntelHexMemoryData::loadFile(filename, target_memory_contents, & error_message);
 	else
-		return SRecordMemoryData::loadFile(QString("troll-test-drive-files/") + outfile + ".srec", target_memory_contents);
+		result = BinaryMemoryData::loadFile(filename, base_address, target_memory_contents, & error_message);
+	profiling.memory_image_load_time = t.elapsed();
+	if (!result)
+	{
+		target_memory_contents = Memory();
+		QMessageBox::warning(0, "error loading memory image file",
+				     "error loading memory image file " + filename + ":\n" + error_message + "\n\n"
+				     "target memory contents will be retrieved from the ELF file instead");
+		return false;
+	}
+	target_memory_contents.dump();
+	return true;
 }
 
 bool MainWindow::loadElfMemorySegments(void)
@@ -859,8 +922,20 @@ std::string MainWindow::typeStringForDieOffset(uint32_t die_offset)
 
 void MainWindow::dumpData(uint32_t address, const QByteArray &data)
 {
+int i;
+QString pointers;
 	ui->plainTextEditDataDump->clear();
 	ui->plainTextEditDataDump->appendPlainText(data.toHex());
+	/* annotate aligned words which look like pointers to static objects */
+	for (i = (4 - (address & 3)) & 3; i + (int) sizeof(uint32_t) <= data.size(); i += sizeof(uint32_t))
+	{
+		uint32_t x = * (uint32_t *) (data.constData() + i);
+		QString symbol;
+		if (x && !(symbol = static_object_index.describeAddress(x)).isEmpty())
+			pointers += QString("$%1: $%2 <%3>\n").arg(address + i, 8, 16, QChar('0')).arg(x, 8, 16, QChar('0')).arg(symbol);
+	}
+	if (!pointers.isEmpty())
+		ui->plainTextEditDataDump->appendPlainText("\npointers to static objects:\n" + pointers);
 }
 
 void MainWindow::updateBreakpointsView(void)
@@ -1047,35 +1122,14 @@ there:
 		exit(1);
 	debug_file.setFileName(elf_filename);
 
-	loadElfMemorySegments();
-
-	if (TEST_DRIVE_MODE)
 	{
-		QFile f("troll-test-drive-files/disassembly.txt");
-		f.open(QFile::ReadOnly);
-		disassembly = new Disassembly(f.readAll(), target_memory_contents);
+		auto memory_image_filename = s.value("memory-image-file").toString();
+		if (memory_image_filename.isEmpty() || !loadMemoryImageFile(memory_image_filename, s.value("memory-image-base-address", 0).toString().toUInt(0, 0)))
+			loadElfMemorySegments();
 	}
-	else
-	{
-		QProcess objdump;
-		objdump.start("arm-none-eabi-objdump", QStringList() << "-d" << elf_filename);
-		objdump.waitForFinished();
 
-		if (objdump.error() != QProcess::UnknownError || objdump.exitCode() || objdump.exitStatus() != QProcess::NormalExit)
-		{
-			QMessageBox::critical(0, "error disassembling the target ELF file",
-			                      "error running the 'arm-none-eabi-objdump' utility in order to disassemble\n"
-			                      "the target ELF file!\n\n"
-			                      "please, make sure that the 'arm-none-eabi-objdump' utility is accessible\n"
-			                      "in your path environment, and that the file you have specified\n"
-			                      "is indeed an ELF file!\n\n"
-			                      "disassembly will be unavailable in this session!"
-			                      );
-			disassembly = new Disassembly(QByteArray(), target_memory_contents);
-		}
-		else
-			disassembly = new Disassembly(objdump.readAll(), target_memory_contents);
-	}
+	elf_symbols.build(elf);
+	disassembly = new Disassembly(elf, target_memory_contents, elf_symbols);
 	if (!debug_file.open(QFile::ReadOnly))
 	{
 		QMessageBox::critical(0, "error opening target executable", QString("error opening file ") + debug_file.fileName());
@@ -1112,21 +1166,24 @@ there:
 			}
 		QStringList saved_breakpoints = s.value("machine-level-breakpoints", QStringList()).toStringList();
 		rx.setPattern("([^>]+)>([^>]*)");
+		std::vector<uint32_t> addresses;
+		QVector<bool> enabled;
 		for (i = 0; i < saved_breakpoints.length(); i ++)
 			if (rx.indexIn(saved_breakpoints[i]) != -1)
-			{
-				uint32_t address = rx.cap(1).toUInt();
-	
-				auto x = dwdata->sourceCodeCoordinatesForAddress(address);
-				BreakpointCache::SourceCodeBreakpoint b;
-				b.source_filename = QString::fromStdString(x.file_name);
-				b.directory_name = QString::fromStdString(x.directory_name);
-				b.compilation_directory = QString::fromStdString(x.compilation_directory_name);
-				b.line_number = x.line;
-				b.addresses.push_back(address);
-				b.enabled = (rx.cap(2) == "enabled");
-				breakpoints.addMachineAddressBreakpoint((struct BreakpointCache::MachineAddressBreakpoint){ .address = address, .inferred_breakpoint = b, .enabled = b.enabled, });
-			}
+				addresses.push_back(rx.cap(1).toUInt()), enabled.push_back(rx.cap(2) == "enabled");
+		auto coordinates = dwdata->sourceCodeCoordinatesForAddresses(addresses);
+		for (i = 0; i < addresses.size(); i ++)
+		{
+			const auto & x = coordinates.at(i);
+			BreakpointCache::SourceCodeBreakpoint b;
+			b.source_filename = QString::fromStdString(x.file_name);
+			b.directory_name = QString::fromStdString(x.directory_name);
+			b.compilation_directory = QString::fromStdString(x.compilation_directory_name);
+			b.line_number = x.line;
+			b.addresses.push_back(addresses.at(i));
+			b.enabled = enabled.at(i);
+			breakpoints.addMachineAddressBreakpoint((struct BreakpointCache::MachineAddressBreakpoint){ .address = addresses.at(i), .inferred_breakpoint = b, .enabled = b.enabled, });
+		}
 		updateBreakpointsView();
 		ui->treeWidgetBreakpoints->blockSignals(false);
 	}
@@ -1146,7 +1203,7 @@ there:
 		gdbserver = new GdbServer(target);
 	}
 	else
-		target = new TargetCorefile("flash.bin", 0x08000000, "ram.bin", 0x20000000, "registers.bin");
+		target = createCorefileTarget();
 	
 	sforth_console = ui->plainTextEditSforthConsole;
 	sforth = new Sforth(sforth_console_output_function);
@@ -1177,6 +1234,10 @@ there:
 	dwdata->reapStaticObjects(data_objects, subprograms);
 	profiling.static_storage_duration_data_reap_time = t.elapsed();
 	qDebug() << "static storage duration data reaped in" << profiling.static_storage_duration_data_reap_time << "milliseconds";
+	t.restart();
+	static_object_index.build(dwdata, data_objects, elf_symbols);
+	profiling.static_object_index_build_time = t.elapsed();
+	qDebug() << "static object address index built in" << profiling.static_object_index_build_time << "milliseconds";
 	qDebug() << "data objects:" << data_objects.size() << ", subprograms:" << subprograms.size();
 	populateFunctionsListView();
 	t.restart();
@@ -1204,7 +1265,6 @@ there:
 	profiling.debugger_startup_time = startup_time.elapsed();
 	qDebug() << "debugger startup time:" << profiling.debugger_startup_time << "milliseconds";
 
-	connect(& blackstrike_port, SIGNAL(error(QSerialPort::SerialPortError)), this, SLOT(blackstrikeError(QSerialPort::SerialPortError)));
 	
 	populateSourceFilesView(false);
 
@@ -1286,17 +1346,38 @@ uint32_t pc = -1;
 
 	ui->treeWidgetDataObjects->clear();
 
+	/* First, evaluate the locations of all local data objects, and gather the target memory
+	 * ranges that need to be read, so that they can all be read from the target in a single batch */
+	std::vector<std::vector<DwarfTypeNode> > type_caches(locals.size());
+	std::vector<DwarfEvaluator::DwarfExpressionValue> locations(locals.size());
+	QStringList location_sforth_codes;
+	QVector<QPair<uint32_t, int> > memory_ranges;
 	for (i = 0; i < locals.size(); i ++)
 	{
-		QString data_object_name;
 		ui->tableWidgetLocalVariables->insertRow(row = ui->tableWidgetLocalVariables->rowCount());
-		ui->tableWidgetLocalVariables->setItem(row, 0, new QTableWidgetItem(data_object_name = QString(dwdata->nameOfDie(locals.at(i)))));
-		std::vector<DwarfTypeNode> type_cache;
-		dwdata->readType(locals.at(i).offset, type_cache);
-		ui->tableWidgetLocalVariables->setItem(row, 1, new QTableWidgetItem(QString("%1").arg(dwdata->sizeOf(type_cache))));
-		locationSforthCode = QString::fromStdString(dwdata->locationSforthCode(locals.at(i), context.at(0), pc));
+		ui->tableWidgetLocalVariables->setItem(row, 0, new QTableWidgetItem(QString(dwdata->nameOfDie(locals.at(i)))));
+		dwdata->readType(locals.at(i).offset, type_caches[i]);
+		ui->tableWidgetLocalVariables->setItem(row, 1, new QTableWidgetItem(QString("%1").arg(dwdata->sizeOf(type_caches[i]))));
+		location_sforth_codes << QString::fromStdString(dwdata->locationSforthCode(locals.at(i), context.at(0), pc));
 		ui->tableWidgetLocalVariables->setItem(row, 3, currently_evaluated_local_data_object = new QTableWidgetItem("n/a"));
-		auto location = dwarf_evaluator->evaluateLocation(cfa_value, frameBaseSforthCode, locationSforthCode);
+		locations[i] = dwarf_evaluator->evaluateLocation(cfa_value, frameBaseSforthCode, location_sforth_codes.back());
+		DwarfEvaluator::memoryRangesForLocation(locations[i], dwdata->sizeOf(type_caches[i]), memory_ranges);
+	}
+	Memory prefetched_memory;
+	if (!memory_ranges.isEmpty())
+	{
+		auto data = target->readRanges(memory_ranges);
+		for (i = 0; i < data.size(); i ++)
+			if (!data.at(i).isEmpty())
+				prefetched_memory.addRange(memory_ranges.at(i).first, data.at(i));
+	}
+
+	for (i = 0; i < locals.size(); i ++)
+	{
+		QString data_object_name(ui->tableWidgetLocalVariables->item(row = i, 0)->text());
+		auto & type_cache = type_caches[i];
+		const auto & location = locations[i];
+		locationSforthCode = location_sforth_codes.at(i);
 		if (location.type == DwarfEvaluator::DwarfExpressionValue::INVALID)
 			ui->tableWidgetLocalVariables->setItem(row, 2, new QTableWidgetItem("cannot evaluate"));
 		else
@@ -1339,7 +1420,7 @@ uint32_t pc = -1;
 			auto n = new QTreeWidgetItem(QStringList() << data_object_name);
 			resolveVariableLengthArrayDimensions(node);
 			n->setText(2, QString("%1").arg(node.bytesize));
-			n->addChild(itemForNode(node, DwarfEvaluator::fetchValueFromTarget(location, target, node.bytesize), 0, base, prefix));
+			n->addChild(itemForNode(node, DwarfEvaluator::fetchValueFromTarget(location, target, node.bytesize, & prefetched_memory), 0, base, prefix));
 			ui->treeWidgetDataObjects->addTopLevelItem(n);
 		}
 		ui->tableWidgetLocalVariables->setItem(row, 4, new QTableWidgetItem(locationSforthCode));
@@ -1366,25 +1447,6 @@ uint32_t pc = -1;
 	qDebug() << "local data objects view built in " << x.elapsed() << "milliseconds";
 }
 
-void MainWindow::blackstrikeError(QSerialPort::SerialPortError error)
-{
-	switch (error)
-	{
-	default:
-		Util::panic();
-	case QSerialPort::NoError:
-	case QSerialPort::TimeoutError:
-		break;
-	case QSerialPort::PermissionError:
-		QMessageBox::critical(0, "error connecting to the blackstrike probe", "error connecting to the blackstrike probe\npermission denied(port already open?)");
-		break;
-	case QSerialPort::ResourceError:
-		QMessageBox::critical(0, "blackmagic probe connection error", "blackmagic probe connection error - probe disconnected?");
-		detachBlackmagicProbe();
-		break;
-	}
-}
-
 void MainWindow::closeEvent(QCloseEvent *e)
 {
 QSettings s("troll.rc", QSettings::IniFormat);
@@ -1428,9 +1490,11 @@ int i;
 	dwdata->dumpStats();
 	qDebug() << "frontend profiling stats (all times in milliseconds):";
 	qDebug() << "time for reading all debug sections from disk:" << profiling.debug_sections_disk_read_time;
+	qDebug() << "time for loading the memory image file:" << profiling.memory_image_load_time;
 	qDebug() << "time for processing all of the .debug_info data:" << profiling.all_compilation_units_processing_time;
 	qDebug() << "time for processing the whole .debug_lines section:" << profiling.debug_lines_processing_time;
 	qDebug() << "time for gathering data on all static storage duration data and subprograms:" << profiling.static_storage_duration_data_reap_time;
+	qDebug() << "time for building the static storage duration data address index:" << profiling.static_object_index_build_time;
 	qDebug() << "time for building the static storage duration data and subprograms views:" << profiling.static_storage_duration_display_view_build_time;
 	qDebug() << "!!! total debugger startup time:" << profiling.debugger_startup_time;
 	qDebug() << "maximum time for retrieving line and addresses for a source code file:" << profiling.max_addresses_for_file_retrieval_time;
@@ -1440,6 +1504,9 @@ int i;
 	qDebug() << "maximum time for generating a context view:" << profiling.max_context_view_generation_time;
 	qDebug() << "maximum time for retrieving breakpoint addresses for a source code line(filtered):" << profiling.max_time_for_retrieving_breakpoint_addresses_for_line;
 	qDebug() << "maximum time for retrieving breakpoint addresses for a source code line(unfiltered):" << profiling.max_time_for_retrieving_unfiltered_breakpoint_addresses_for_line;
+	qDebug() << "target halt notification latency, in microseconds (maximum, average, number of halts):" << profiling.max_halt_notification_latency
+		 << (profiling.halt_notification_count ? profiling.total_halt_notification_latency / profiling.halt_notification_count : 0)
+		 << profiling.halt_notification_count;
 	QMainWindow::closeEvent(e);
 }
 
@@ -1531,28 +1598,28 @@ static unsigned accumulator;
 					if ((j = breakpoints.sourceBreakpointIndex(b)) == -1
 							|| is_running_to_cursor)
 					{
-						auto x = dwdata->filteredAddressesForFileAndLineNumber(current_source_view.filename.toLocal8Bit().constData(), i);
-						qDebug() << "filtered addresses:" << x.size();
-						if (x.empty())
+						auto addresses = breakpointAddressesForLine(i);
+						qDebug() << "filtered addresses:" << addresses.size();
+						if (addresses.empty())
 							break;
 						if (is_running_to_cursor)
 						{
-							for (i = 0; i < x.size(); i ++)
+							for (auto address : addresses)
 							{
 								struct BreakpointCache::MachineAddressBreakpoint b;
-								b.address = x.at(i);
+								b.address = address;
 								b.enabled = true;
 								run_to_cursor_breakpoints.addMachineAddressBreakpoint(b);
 							}
 							on_actionResume_triggered();
 							break;
 						}
-						b.addresses = QVector<uint32_t>::fromStdVector(x);
+						b.addresses = addresses;
 						breakpoints.addSourceCodeBreakpoint(b);
 						if (t.elapsed() > profiling.max_time_for_retrieving_breakpoint_addresses_for_line)
 							profiling.max_time_for_retrieving_breakpoint_addresses_for_line = t.elapsed();
 						t.restart();
-						x = dwdata->unfilteredAddressesForFileAndLineNumber(current_source_view.filename.toLocal8Bit().constData(), i);
+						auto x = dwdata->unfilteredAddressesForFileAndLineNumber(current_source_view.filename.toLocal8Bit().constData(), i);
 						if (t.elapsed() > profiling.max_time_for_retrieving_unfiltered_breakpoint_addresses_for_line)
 							profiling.max_time_for_retrieving_unfiltered_breakpoint_addresses_for_line = t.elapsed();
 						qDebug() << "total addresses:" << x.size();
@@ -1664,20 +1731,37 @@ static unsigned accumulator;
 void MainWindow::on_actionSingle_step_triggered()
 {
 	execution_state = FREE_RUNNING;
+	removeBreakpointAtProgramCounter();
 	target->requestSingleStep();
 }
 
 void MainWindow::on_actionSource_step_triggered()
 {
 	execution_state = SOURCE_LEVEL_SINGLE_STEPPING;
+	removeBreakpointAtProgramCounter();
 	target->requestSingleStep();
 }
 
+void MainWindow::removeBreakpointAtProgramCounter(void)
+{
+	auto b = breakpoints.installedMachineAddressBreakpoints;
+	/*! \todo	this is evil, make this portable */
+	if (b.remove(target->readRawUncachedRegister(15)))
+		breakpoints.syncTargetBreakpoints(target, b);
+}
+
 void MainWindow::on_actionBlackstrikeConnect_triggered()
 {
 auto ports = QSerialPortInfo::availablePorts();
+QSettings settings("troll.rc", QSettings::IniFormat);
+QStringList transports;
 int i;
 class Target * t;
+	/* a probe transport configured explicitly (e.g., 'tcp:host:port', for probes reached
+	 * through a network bridge), if any, is tried first */
+	auto configured_transport = settings.value("probe-transport").toString();
+	if (!configured_transport.isEmpty())
+		transports << configured_transport;
 	/* Note: prefer reverse iterating of the serial ports, because, at least on the machine I am testing on,
 	 * it seems that Windows enumerates the serial ports in such a manner, that the blackmagic
 	 * serial wire output/debug serial port gets a number that is lower
@@ -1688,40 +1772,48 @@ class Target * t;
 	{
 		qDebug() << ports[i].manufacturer() << ports.at(i).description() << ports.at(i).serialNumber() << ports.at(i).portName();
 		if (ports.at(i).hasProductIdentifier() && ports.at(i).vendorIdentifier() == BLACKMAGIC_USB_VENDOR_ID)
+			transports << "serial:" + ports.at(i).portName();
+	}
+	for (i = 0; i < transports.size(); i ++)
+	{
+		auto blackmagic = new Blackmagic(transports.at(i));
+		blackmagic->setPipelineDepth(settings.value("probe-pipeline-depth", (int) Blackmagic::DEFAULT_PIPELINE_DEPTH).toInt());
+		blackmagic->setTransportTuning(settings.value("probe-write-coalescing-limit", -1).toInt(), settings.value("probe-read-batching-delay", -1).toInt());
+		t = blackmagic;
+		if (!t->connect())
 		{
-			blackstrike_port.setPortName(ports.at(i).portName());
-			if (blackstrike_port.open(QSerialPort::ReadWrite))
-			{
-				t = new Blackmagic(& blackstrike_port);
-				if (!t->connect())
-				{
-					delete t;
+			delete t;
 #if BLACKSTRIKE_SUPPORT_ENABLED
-					t = new Blackstrike(& blackstrike_port);
-					if (!t->connect())
-					{
-						blackstrike_port.close();
-						delete t;
-						continue;
-					}
+			auto transport = ProbeTransport::create(transports.at(i));
+			if (!transport || !transport->open())
+			{
+				delete transport;
+				continue;
+			}
+			t = new Blackstrike(transport);
+			if (!t->connect())
+			{
+				delete t;
+				continue;
+			}
 #else
-					blackstrike_port.close();
-					continue;
+			continue;
 #endif /* BLACKSTRIKE_SUPPORT_ENABLED */
-				}
-				auto s = t->memoryMap();
-				t->parseMemoryAreas(s);
-				if (!t->syncFlash(target_memory_contents))
-				{
-					QMessageBox::critical(0, "memory contents mismatch", "target memory contents mismatch");
-					Util::panic();
-				}
-				else
-					QMessageBox::information(0, "memory contents match", "target memory contents match");
-				attachBlackmagicProbe(t);
-				return;
-			}
 		}
+		connect(t, SIGNAL(flashProgress(FLASH_PROGRAMMING_PHASE,uint,uint,uint)), this, SLOT(flashProgress(FLASH_PROGRAMMING_PHASE,uint,uint,uint)));
+		auto s = t->memoryMap();
+		t->parseMemoryAreas(s);
+		t->setImmutableMemoryPolicy(settings.value("serve-immutable-memory-from-image", true).toBool(),
+					    settings.value("immutable-memory-spot-check-interval", 0).toInt());
+		if (!t->syncFlash(target_memory_contents))
+		{
+			QMessageBox::critical(0, "memory contents mismatch", "target memory contents mismatch");
+			Util::panic();
+		}
+		else
+			QMessageBox::information(0, "memory contents match", "target memory contents match");
+		attachBlackmagicProbe(t);
+		return;
 	}
 	QMessageBox::warning(0, "blackstrike port not found", "cannot find blackstrike gdbserver port ");
 }
@@ -1856,6 +1948,14 @@ int i;
 		f.write((const char * ) & x, sizeof x);
 	}
 	f.close();
+	f.setFileName(dirname + "/core.manifest");
+	if (!f.open(QFile::WriteOnly))
+		Util::panic();
+	f.write("# snapshot manifest - set the 'core-file' key in the 'troll.rc' file to this file to examine this snapshot\n"
+		"memory 0x08000000 flash.bin\n"
+		"memory 0x20000000 ram.bin\n"
+		"registers registers.bin\n");
+	f.close();
 	f.setFileName(elf_filename);
 	if (!f.copy(dirname + "/" + QFileInfo(elf_filename).fileName()))
 		Util::panic();
@@ -1871,19 +1971,13 @@ void MainWindow::on_actionResume_triggered()
 {
 auto b = breakpoints.enabledMachineAddressBreakpoints + run_to_cursor_breakpoints.enabledMachineAddressBreakpoints;
 enum TARGET_STATE_ENUM new_target_state = FREE_RUNNING;
-	auto x = b.find(address_of_step_over_breakpoint = target->readRawUncachedRegister(15));
-	if (x != b.end())
-		b.erase(x), new_target_state = STEPPING_OVER_BREAKPOINT_AND_THEN_RESUMING;
-auto breakpointed_addresses = b.constBegin();
-
-	while (breakpointed_addresses != b.constEnd())
+	/* if there is a breakpoint at the current program counter, step over it first */
+	if (b.remove(address_of_step_over_breakpoint = target->readRawUncachedRegister(15)))
+		new_target_state = STEPPING_OVER_BREAKPOINT_AND_THEN_RESUMING;
+	if (!breakpoints.syncTargetBreakpoints(target, b))
 	{
-		if (!target->breakpointSet(* breakpointed_addresses, 2))
-		{
-			QMessageBox::critical(0, "Failed to set breakpoint", "Failed to set breakpoint!\nToo many breakpoints requested?\nTarget execution aborted");
-			return;
-		}
-		breakpointed_addresses ++;
+		QMessageBox::critical(0, "Failed to set breakpoint", "Failed to set breakpoint!\nToo many breakpoints requested?\nTarget execution aborted");
+		return;
 	}
 	execution_state = new_target_state;
 	if (execution_state == STEPPING_OVER_BREAKPOINT_AND_THEN_RESUMING)
@@ -1948,6 +2042,15 @@ int row(ui->tableWidgetFunctions->currentRow());
 
 void MainWindow::targetHalted(TARGET_HALT_REASON reason)
 {
+	if (auto t = target->haltTimestamp())
+	{
+		unsigned latency = (Target::timestamp() - t) / 1000;
+		if (latency > profiling.max_halt_notification_latency)
+			profiling.max_halt_notification_latency = latency;
+		profiling.total_halt_notification_latency += latency;
+		profiling.halt_notification_count ++;
+		qDebug() << "target halt notification latency:" << latency << "microseconds";
+	}
 	if (reason == TARGET_LOST)
 	{
 		polishing_timer.stop();
@@ -1971,7 +2074,7 @@ void MainWindow::targetHalted(TARGET_HALT_REASON reason)
 		}
 		break;
 		case STEPPING_OVER_BREAKPOINT_AND_THEN_RESUMING:
-			if (!target->breakpointSet(address_of_step_over_breakpoint, 2))
+			if (!breakpoints.syncTargetBreakpoints(target, breakpoints.enabledMachineAddressBreakpoints + run_to_cursor_breakpoints.enabledMachineAddressBreakpoints))
 				Util::panic();
 			execution_state = FREE_RUNNING;
 			target->resume();
@@ -1980,19 +2083,13 @@ void MainWindow::targetHalted(TARGET_HALT_REASON reason)
 		case FREE_RUNNING:
 			break;
 	}
-	auto b = run_to_cursor_breakpoints.enabledMachineAddressBreakpoints.constBegin();
-	while (b != run_to_cursor_breakpoints.enabledMachineAddressBreakpoints.constEnd())
-		target->breakpointClear(* b, 2), b ++;
+	/* Note: breakpoints are left installed on the target - they are only updated
+	 * (if needed at all) when the target is resumed, or single-stepped; run to cursor
+	 * breakpoints still installed get removed then */
 	run_to_cursor_breakpoints.removeAll();
 
 	execution_state = HALTED;
 
-	auto breakpointed_addresses = breakpoints.enabledMachineAddressBreakpoints.constBegin();
-	while (breakpointed_addresses != breakpoints.enabledMachineAddressBreakpoints.constEnd())
-	{
-		target->breakpointClear(* breakpointed_addresses, 2);
-		breakpointed_addresses ++;
-	}
 	polishing_timer.stop();
 	switchActionOff(ui->actionBlackstrikeConnect);
 	switchActionOn(ui->actionSingle_step);
@@ -2040,12 +2137,17 @@ static const char * x[8] = { ">   ", " >  ", "  > ", "   >", "   <", "  < ", " <
 	//ui->actionTarget_status->setText(QString("target running [%1]").arg(c[i ++]));
 	ui->actionTarget_status->setText(QString("target running [%1]").arg(x[i ++]));
 	i &= 7;
-	/*! \todo	WARNING - it seems that I am doing something wrong with the 'readyRead()' signal;
-	 *		without the call to 'waitForReadyRead()' below, on one machine that I am testing on,
-	 *		incoming data from the blackmagic probe sometimes does not cause the 'readyRead()'
-	 *		signal to be emitted, which breaks the code badly; I discovered through trial and
-	 *		error that the call to 'WaitForReadyRead()' function below seems to work around this issue */
-	blackstrike_port.waitForReadyRead(1);
+}
+
+void MainWindow::flashProgress(FLASH_PROGRAMMING_PHASE phase, unsigned bytes_done, unsigned bytes_total, unsigned bytes_per_second)
+{
+	static const char * phases[] = { "comparing flash contents", "erasing flash", "writing flash", "verifying target memory contents", };
+	auto s = QString("%1: %2 of %3 bytes").arg(phases[phase]).arg(bytes_done).arg(bytes_total);
+	if (bytes_per_second)
+		s += QString(", %1 bytes per second").arg(bytes_per_second);
+	statusBar()->showMessage(s);
+	if (bytes_done == bytes_total)
+		qDebug() << s;
 }
 
 void MainWindow::targetRunning()
@@ -2116,7 +2218,24 @@ void MainWindow::on_lineEditSubprograms_returnPressed()
 	{
 		ui->tableWidgetFunctions->scrollToItem(x.at(0), QAbstractItemView::PositionAtTop);
 		ui->tableWidgetFunctions->selectRow(x[0]->row());
+		return;
+	}
+	/* no debug information for the subprogram - if there is a function with this name in the
+	 * ELF symbol table, place a breakpoint at it */
+	auto symbol = elf_symbols.symbolForName(ui->lineEditSubprograms->text());
+	if (!symbol || !symbol->is_function)
+		return;
+	if (breakpoints.machineBreakpointIndex(symbol->address) == -1)
+	{
+		BreakpointCache::SourceCodeBreakpoint b;
+		b.source_filename = symbol->name;
+		b.line_number = 0;
+		b.addresses.push_back(symbol->address);
+		breakpoints.addMachineAddressBreakpoint((struct BreakpointCache::MachineAddressBreakpoint){ .address = symbol->address, .inferred_breakpoint = b, .enabled = true, });
+		updateBreakpointsView();
+		colorizeSourceCodeView();
 	}
+	statusBar()->showMessage(QString("breakpoint set at function %1 (no debug information), address $%2").arg(symbol->name).arg(symbol->address, 8, 16, QChar('0')));
 }
 
 void MainWindow::on_pushButtonCreateBookmark_clicked()
@@ -27,6 +27,8 @@ THE SOFTWARE.
 #include <QTableWidget>
 #include <QFileSystemWatcher>
 #include <QPlainTextEdit>
+#include <QDateTime>
+#include <QHash>
 #include <elfio/elfio.hpp>
 
 #include "libtroll.hxx"
@@ -42,6 +44,10 @@ THE SOFTWARE.
 #include <QTimer>
 #include <QAction>
 #include "s-record.hxx"
+#include "intel-hex.hxx"
+#include "binary-image.hxx"
+#include "elf-symbol-index.hxx"
+#include "static-object-address-index.hxx"
 #include "disassembly.hxx"
 #include "breakpoint-cache.hxx"
 #include "gdbserver.hxx"
@@ -97,6 +103,22 @@ class MainWindow : public QMainWindow
 		QMap<int /* line number */, int /* line position in text document */> line_positions_in_document;
 	}
 	src;
+	/* Interleaved source code and disassembly views of source code files. These are built in a single pass over a source
+	 * code file and its line table rows, and are cached, so that redisplaying a source code file is fast */
+	struct InterleavedSourceView
+	{
+		QDateTime	source_file_modification_time;
+		QString		text;
+		bool		is_html = false;
+		QMap<uint32_t /* address */, int /* line position in text document */> address_positions_in_document;
+		QMap<int /* line number */, int /* line position in text document */> line_positions_in_document;
+		/* addresses suitable for placing breakpoints, for source code lines; filled on demand */
+		QHash<int /* line number */, QVector<uint32_t> > breakpoint_addresses_for_line;
+	};
+	QHash<QPair<QString /* canonical file name */, bool /* is disassembly shown */>, InterleavedSourceView> interleaved_source_views;
+	QPair<QString, bool> current_interleaved_source_view_key;
+	InterleavedSourceView * interleavedSourceView(const QString & canonical_filename, const QString & source_filename);
+	QVector<uint32_t> breakpointAddressesForLine(int line_number);
 public:
 	struct TreeWidgetNodeData
 	{
@@ -125,10 +147,12 @@ private:
 	void refreshSourceCodeView(int center_line = -1);
 	void backtrace(void);
 	bool readElfSections(void);
-	bool loadSRecordFile(void);
+	bool loadMemoryImageFile(const QString & filename, uint32_t base_address);
+	Target * createCorefileTarget(void);
 	bool loadElfMemorySegments(void);
 	QString elf_filename;
 	ELFIO::elfio elf;
+	ElfSymbolIndex elf_symbols;
 	void updateRegisterView(void);
 	std::string typeStringForDieOffset(uint32_t die_offset);
 	void dumpData(uint32_t address, const QByteArray & data);
@@ -138,11 +162,14 @@ private:
 	void showDisassembly(void);
 	void attachBlackmagicProbe(Target * blackmagic);
 	void detachBlackmagicProbe(void);
+	/* removes the breakpoint installed at the current program counter (if any), so that the target can be single-stepped */
+	void removeBreakpointAtProgramCounter(void);
 	void displayVerboseDataTypeForDieOffset(uint32_t die_offset);
 	static QPlainTextEdit * sforth_console;
 	static void sforth_console_output_function(const QString & console_output) { sforth_console->appendPlainText(console_output); }
 
 	std::vector<struct StaticObject> data_objects, subprograms;
+	StaticObjectAddressIndex static_object_index;
 
 	void populateFunctionsListView(bool merge_duplicates = true);
 
@@ -177,7 +204,6 @@ private slots:
 	void dwarfEntryValueComputed(struct DwarfEvaluator::DwarfExpressionValue entry_value);
 	void on_lineEditSforthCommand_returnPressed();
 	void on_tableWidgetBacktrace_itemSelectionChanged();
-	void blackstrikeError(QSerialPort::SerialPortError error);
 	
 	void on_actionSingle_step_triggered();
 	
@@ -212,6 +238,7 @@ private slots:
 	
 	void targetHalted(enum TARGET_HALT_REASON reason);
 	void targetRunning(void);
+	void flashProgress(enum FLASH_PROGRAMMING_PHASE phase, unsigned bytes_done, unsigned bytes_total, unsigned bytes_per_second);
 	void targetDisconnected(void);
 	void targetConnected(void);
 	void polishSourceCodeViewOnTargetExecution(void);
@@ -259,14 +286,15 @@ protected:
 private:
 	GdbServer * gdbserver;
 	Ui::MainWindow *ui;
-	QSerialPort	blackstrike_port;
 	/* all times are in milliseconds */
 	struct
 	{
 		unsigned	debug_sections_disk_read_time;
+		unsigned	memory_image_load_time;
 		unsigned	all_compilation_units_processing_time;
 		unsigned	debug_lines_processing_time;
 		unsigned	static_storage_duration_data_reap_time;
+		unsigned	static_object_index_build_time;
 		unsigned	static_storage_duration_display_view_build_time;
 		unsigned	debugger_startup_time;
 		unsigned	max_backtrace_generation_time;
@@ -276,6 +304,11 @@ private:
 		unsigned	max_local_data_objects_view_build_time;
 		unsigned	max_time_for_retrieving_breakpoint_addresses_for_line;
 		unsigned	max_time_for_retrieving_unfiltered_breakpoint_addresses_for_line;
+		/* the time from receiving a target halt notification from a debug probe, to the notification
+		 * reaching the front-end; these are in microseconds */
+		unsigned	max_halt_notification_latency;
+		uint64_t	total_halt_notification_latency;
+		unsigned	halt_notification_count;
 	}
 	profiling;
 };
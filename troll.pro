@@ -37,6 +37,8 @@ SOURCES +=\
     dwarf-evaluator.cxx \
     troll.cxx \
     blackmagic.cxx \
+    probe-io.cxx \
+    probe-transport.cxx \
     gdb-remote.cxx \
     external-sources/capstone/cs.c \
     external-sources/capstone/MCInst.c \
@@ -51,7 +53,8 @@ SOURCES +=\
     breakpoint-cache.cxx \
     dwarf-evaluator-sfext.c \
     dwarf-type-stack-sfext.c \
-    gdbserver.cxx
+    gdbserver.cxx \
+    crash-triage.cxx
 
 HEADERS  += \
     libtroll/dwarf.h \
@@ -65,15 +68,24 @@ HEADERS  += \
     registercache.hxx \
     memory.hxx \
     s-record.hxx \
+    intel-hex.hxx \
+    binary-image.hxx \
+    elf-symbol-index.hxx \
+    elf-debug-data.hxx \
+    static-object-address-index.hxx \
     disassembly.hxx \
     dwarf-evaluator.hxx \
     troll.hxx \
     blackmagic.hxx \
+    probe-io.hxx \
+    probe-transport.hxx \
     gdb-remote.hxx \
+    crc32.hxx \
     breakpoint-cache.hxx \
     target-arch.hxx \
     dwarf-type-stack.hxx \
-    gdbserver.hxx
+    gdbserver.hxx \
+    crash-triage.hxx
 
 FORMS    += mainwindow.ui \
     notification.ui
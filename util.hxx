@@ -27,8 +27,27 @@ class Util
 {
 public:
 	static void panic(...) { *(int*)0=0; }
+	/* Set when running without a graphical user interface (e.g., in batch mode); message boxes must not be shown then */
+	static bool & isHeadless(void) { static bool is_headless = false; return is_headless; }
 	template<typename T> static T min(T x, T y) { return x < y ? x : y; }
 	template<typename T> static T max(T x, T y) { return x > y ? x : y; }
+	/* Decodes the two hexadecimal digits at the location passed; returns -1 if these are not valid hexadecimal digits */
+	static int hexByte(const char * s)
+	{
+		static const struct hex_digit_table
+		{
+			signed char values[256];
+			hex_digit_table(void)
+			{
+				int i;
+				for (i = 0; i < 256; values[i ++] = -1);
+				for (i = 0; i < 10; i ++) values['0' + i] = i;
+				for (i = 0; i < 6; i ++) values['a' + i] = values['A' + i] = 10 + i;
+			}
+		} table;
+		int h = table.values[(unsigned char) s[0]], l = table.values[(unsigned char) s[1]];
+		return (h | l) < 0 ? -1 : (h << 4) | l;
+	}
 };
 
 #endif // UTIL_H